@@ -0,0 +1,69 @@
+#include "Smoothie.h"
+#include <cstdio>
+#include <cstdlib>
+
+void PerfCounters::recordBlock(uint64 cycles)
+{
+	add(PerfBlocks, 1);
+	add(PerfCyclesTotal, cycles);
+	if (cycles > counters[PerfCyclesMax].load(std::memory_order_relaxed))
+		counters[PerfCyclesMax].store(cycles, std::memory_order_relaxed);
+
+	uint32 bucket = 0;
+	for (uint64 c = cycles >> 1; c && bucket + 1 < perf_histogram_buckets; c >>= 1)
+		++bucket;
+	add(PerfHistogram + bucket, 1);
+}
+
+void PerfCounters::snapshot(uint64 (&out)[NumPerfCounters]) const
+{
+	for (uint32 i = 0; i < NumPerfCounters; ++i)
+		out[i] = counters[i].load(std::memory_order_relaxed);
+}
+
+static FILE* open_perf_log()
+{
+	FILE* f = nullptr;
+#ifdef _MSC_VER
+	char* path = nullptr;
+	size_t len = 0;
+	if (_dupenv_s(&path, &len, perf_log_env) == 0 && path)
+	{
+		if (fopen_s(&f, path, "a") != 0)
+			f = nullptr;
+		free(path);
+	}
+#else
+	if (const char* path = getenv(perf_log_env))
+		f = fopen(path, "a");
+#endif
+	return f;
+}
+
+void PerfCounters::dump(const void* instance, const uint64 (&snap)[NumPerfCounters])
+{
+	FILE* f = open_perf_log();
+	if (!f)
+		return;
+
+	const unsigned long long blocks = snap[PerfBlocks];
+	fprintf(f, "Smoothie instance %p: %llu blocks, %llu cycles total, %llu cycles/block average, %llu cycles/block max\n",
+		instance, blocks, (unsigned long long)snap[PerfCyclesTotal],
+		blocks ? (unsigned long long)(snap[PerfCyclesTotal] / blocks) : 0ULL, (unsigned long long)snap[PerfCyclesMax]);
+
+	for (uint32 i = 0; i < num_smoothed_params; ++i)
+	{
+		const uint64* in = snap + PerfInPoints + i * NumParamOffsets;
+		fprintf(f, "  triad %u: received %llu InParam, %llu OutParam, %llu Slowness/FallSlowness points (%llu dropped over budget or not a number); emitted %llu OutParam points, %llu CC events (%llu dropped for lack of storage); %llu override segments\n",
+			i + 1, (unsigned long long)in[InParamOffset], (unsigned long long)in[OutParamOffset], (unsigned long long)in[SlownessOffset],
+			(unsigned long long)snap[PerfDroppedPoints + i], (unsigned long long)snap[PerfOutPoints + i], (unsigned long long)snap[PerfCCEvents + i],
+			(unsigned long long)snap[PerfDroppedCC + i], (unsigned long long)snap[PerfOverrides + i]);
+	}
+
+	fprintf(f, "  process() duration histogram (cycles: blocks):\n");
+	for (uint32 b = 0; b < perf_histogram_buckets; ++b)
+		if (snap[PerfHistogram + b])
+			fprintf(f, "    [2^%u, 2^%u): %llu\n", b, b + 1, (unsigned long long)snap[PerfHistogram + b]);
+
+	fclose(f);
+}
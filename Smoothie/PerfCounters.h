@@ -0,0 +1,67 @@
+#pragma once
+
+// Included by Smoothie.h, after the parameter layout constants that size the counter table.
+
+#include "pluginterfaces/base/funknown.h"
+#include <atomic>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#else
+#  include <chrono>
+#endif
+
+using namespace Steinberg;
+
+constexpr uint32 perf_histogram_buckets = 40;  // bucket b counts process() calls that took [2^b, 2^(b+1)) cycles
+constexpr const char* perf_log_env = "SMOOTHIE_PERF_LOG";  // if set, terminate() appends the counters to this file
+
+// Counter enumeration (per-triad counters occupy consecutive slots, starting at the listed base)
+enum PerfCounterIndex : uint32
+{
+	PerfBlocks = 0,
+	PerfInPoints = 1,  // + param_set * NumParamOffsets + (InParamOffset | OutParamOffset | SlownessOffset); SlownessOffset also counts FallSlowness points
+	PerfOutPoints = PerfInPoints + num_smoothed_params * NumParamOffsets,  // + param_set
+	PerfCCEvents = PerfOutPoints + num_smoothed_params,  // + param_set
+	PerfOverrides = PerfCCEvents + num_smoothed_params,  // + param_set
+	PerfDroppedPoints = PerfOverrides + num_smoothed_params,  // + param_set; points decimated over the budget or not a number
+	PerfDroppedCC = PerfDroppedPoints + num_smoothed_params,  // + param_set; CC events lost for lack of preallocated storage
+	PerfCyclesTotal = PerfDroppedCC + num_smoothed_params,
+	PerfCyclesMax = PerfCyclesTotal + 1,
+	PerfHistogram = PerfCyclesMax + 1,  // + bucket
+	NumPerfCounters = PerfHistogram + perf_histogram_buckets,
+};
+
+// Message IDs and attribute used to ship a snapshot of the counters from the processor to the controller
+constexpr const char* perf_request_msg = "SmoothiePerfRequest";
+constexpr const char* perf_reply_msg = "SmoothiePerfCounters";
+constexpr const char* perf_reply_attr = "counters";
+
+static inline uint64 perf_cycles()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Per-instance performance counters.  Only the audio thread writes them (without locks or allocation),
+// and any thread may read them, so relaxed atomic loads and stores suffice.
+class PerfCounters
+{
+public:
+	inline void add(uint32 index, uint64 n)
+	{
+		counters[index].store(counters[index].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	void recordBlock(uint64 cycles);
+	void snapshot(uint64 (&out)[NumPerfCounters]) const;
+	static void dump(const void* instance, const uint64 (&snap)[NumPerfCounters]);
+
+private:
+	std::atomic<uint64> counters[NumPerfCounters] = {};
+};
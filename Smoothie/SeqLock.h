@@ -0,0 +1,73 @@
+#pragma once
+
+#include "pluginterfaces/base/funknown.h"
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+using namespace Steinberg;
+
+// Sequence lock guarding one trivially copyable value that has a single writer thread.
+// Writing never blocks or allocates.  A read that overlaps a write is detected and either fails
+// (tryRead) or is retried (read), so readers never observe a torn value.  The payload is stored as
+// relaxed atomic words so that the overlapping accesses are not data races.
+template <class T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+public:
+	SeqLock(void) = default;
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+
+	void write(const T& value)
+	{
+		uint64 buf[num_words] = {};
+		memcpy(buf, &value, sizeof(T));
+
+		const uint32 s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < num_words; ++i)
+			words[i].store(buf[i], std::memory_order_relaxed);
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	// Try once to read the value.  On success, returns true and sets version to the sequence number of
+	// the write that produced it.  Returns false (leaving value unspecified) if a write was in progress.
+	bool tryRead(T& value, uint32& version) const
+	{
+		const uint32 s1 = seq.load(std::memory_order_acquire);
+		if (s1 & 1)
+			return false;
+
+		uint64 buf[num_words];
+		for (size_t i = 0; i < num_words; ++i)
+			buf[i] = words[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq.load(std::memory_order_relaxed) != s1)
+			return false;
+
+		memcpy(&value, buf, sizeof(T));
+		version = s1;
+		return true;
+	}
+
+	void read(T& value) const
+	{
+		uint32 version;
+		while (!tryRead(value, version)) {}
+	}
+
+	// Sequence number of the most recently completed write (0 if never written)
+	uint32 version(void) const
+	{
+		return seq.load(std::memory_order_acquire) & ~(uint32)1;
+	}
+
+private:
+	static constexpr size_t num_words = (sizeof(T) + sizeof(uint64) - 1) / sizeof(uint64);
+	std::atomic<uint32> seq{0};
+	std::atomic<uint64> words[num_words] = {};
+};
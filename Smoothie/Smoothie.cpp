@@ -4,16 +4,21 @@
 #include "pluginterfaces/vst/ivstparameterchanges.h"
 #include "pluginterfaces/vst/ivstprocesscontext.h"
 #include "pluginterfaces/base/ibstream.h"
+#include "pluginterfaces/vst/ivstmessage.h"
 #include "base/source/fstreamer.h"
+#include <cstring>
+#include <cstdlib>
 
 #include "Smoothie.h"
 #include "SmoothieController.h"
+#include "SmoothieState.h"
 
 Smoothie::Smoothie(void)
 {
 	LOG("Smoothie constructor called.\n");
 	setControllerClass(FUID(SmoothieControllerUID));
 	processSetup.maxSamplesPerBlock = INT32_MAX;
+	publishState();
 	LOG("Smoothie constructor exited.\n");
 }
 
@@ -43,11 +48,47 @@ tresult PLUGIN_API Smoothie::initialize(FUnknown* context)
 tresult PLUGIN_API Smoothie::terminate()
 {
 	LOG("Smoothie::terminate called.\n");
+
+	uint64 snap[NumPerfCounters];
+	perf.snapshot(snap);
+	PerfCounters::dump(this, snap);
+
 	tresult result = AudioEffect::terminate();
 	LOG("Smoothie::terminate exited with code %d.\n", result);
 	return result;
 }
 
+tresult PLUGIN_API Smoothie::notify(IMessage* message)
+{
+	LOG("Smoothie::notify called.\n");
+	if (message && !strcmp(message->getMessageID(), perf_request_msg))
+	{
+		uint64 snap[NumPerfCounters];
+		perf.snapshot(snap);
+		IPtr<IMessage> reply = owned(allocateMessage());
+		if (reply)
+		{
+			reply->setMessageID(perf_reply_msg);
+			reply->getAttributes()->setBinary(perf_reply_attr, snap, sizeof(snap));
+			sendMessage(reply);
+		}
+		LOG("Smoothie::notify exited after replying with performance counters.\n");
+		return kResultOk;
+	}
+	tresult result = AudioEffect::notify(message);
+	LOG("Smoothie::notify exited with code %d.\n", result);
+	return result;
+}
+
+// Report how long OutParams keep moving after input stops, so hosts can stop calling process() once
+// every triad is parked (and not before, e.g. mid-fade after transport stop).
+uint32 PLUGIN_API Smoothie::getTailSamples()
+{
+	const uint32 tail = tail_samples.load(std::memory_order_relaxed);
+	LOG("Smoothie::getTailSamples called and exited with %u.\n", tail);
+	return (tail == 0) ? kNoTail : tail;
+}
+
 tresult PLUGIN_API Smoothie::setActive(TBool state)
 {
 	LOG("Smoothie::setActive called.\n");
@@ -73,19 +114,24 @@ tresult PLUGIN_API Smoothie::setState(IBStream* state)
 {
 	LOG("Smoothie::setState called.\n");
 
-	IBStreamer streamer(state, kLittleEndian);
-	for (int32 i = 0; i < num_smoothed_params; ++i)
+	// Start from the most recent state so that a short read leaves the remaining triads unchanged.
+	StateSnapshot snap;
+	if (incoming_state.version() != applied_state_version.load(std::memory_order_acquire))
+		incoming_state.read(snap);
+	else
+		published_state.read(snap);
+
+	const int32 triads = read_state(state, snap.values, num_smoothed_params);
+	if (triads < 0)
 	{
-		double vals[NumParamOffsets];
-		if (!streamer.readDoubleArray(vals, NumParamOffsets))
-		{
-			LOG("Smoothie::setState stopped early with %dx3 records read.\n", i);
-			return kResultOk;
-		}
-		values[i].in = vals[0];
-		values[i].out = vals[1];
-		values[i].slowness = vals[2];
+		LOG("Smoothie::setState failed due to invalid state header.\n");
+		return kResultFalse;
 	}
+	if (triads < num_smoothed_params)
+		LOG("Smoothie::setState stopped early with %d triads read.\n", triads);
+
+	// Hand the new state to the audio thread, which adopts it at its next block boundary.
+	incoming_state.write(snap);
 
 	LOG("Smoothie::setState exited successfully.\n");
 	return kResultOk;
@@ -95,25 +141,113 @@ tresult PLUGIN_API Smoothie::getState(IBStream* state)
 {
 	LOG("Smoothie::getState called.\n");
 
-	IBStreamer streamer(state, kLittleEndian);
-	for (int32 i = 0; i < num_smoothed_params; ++i)
+	// Report a state handed to setState but not yet adopted by the audio thread, if any;
+	// otherwise report the state most recently published by the audio thread.
+	StateSnapshot snap;
+	if (incoming_state.version() != applied_state_version.load(std::memory_order_acquire))
+		incoming_state.read(snap);
+	else
+		published_state.read(snap);
+
+	if (!write_state(state, snap.values, num_smoothed_params))
 	{
-		if (!streamer.writeDoubleArray((ParamValue*)&values[i], NumParamOffsets))
-		{
-			LOG("Smoothie::getState failed due to streamer error.\n");
-			return kResultFalse;
-		}
+		LOG("Smoothie::getState failed due to streamer error.\n");
+		return kResultFalse;
 	}
 
 	LOG("Smoothie::getState exited successfully.\n");
 	return kResultOk;
 }
 
+// Adopt a state handed over by setState, if there is one.  Called only by the audio thread, at a block
+// boundary.  Never blocks:  if setState is mid-write, the new state is picked up at the next block instead.
+void Smoothie::applyIncomingState(void)
+{
+	const uint32 pending = incoming_state.version();
+	if (pending == applied_state_version.load(std::memory_order_relaxed))
+		return;
+
+	StateSnapshot snap;
+	uint32 version;
+	if (!incoming_state.tryRead(snap, version))
+		return;
+
+	memcpy(values, snap.values, sizeof(values));
+	initial_points_sent = false;  // re-send initial points so the host picks up the restored values
+	published_state.write(snap);
+	applied_state_version.store(version, std::memory_order_release);
+}
+
+// Recompute the tail from the current values.  Called only by the audio thread.
+void Smoothie::updateTail(double sampleRate)
+{
+	int64 tail = 0;
+	for (ParamID i = 0; i < num_smoothed_params; ++i)
+	{
+		const int64 n = samples_to_converge(values[i], sampleRate, tempo);
+		if (n > tail)
+			tail = n;
+	}
+	tail_samples.store((tail >= (int64)kInfiniteTail) ? kInfiniteTail - 1 : (uint32)tail, std::memory_order_relaxed);
+}
+
+// Publish the audio thread's current values for getState.  Called only by the audio thread.
+void Smoothie::publishState(void)
+{
+	StateSnapshot snap;
+	memcpy(snap.values, values, sizeof(values));
+	published_state.write(snap);
+}
+
+// Read the per-curve point budget from the environment, if set
+static int32 get_point_budget(void)
+{
+	int32 budget = default_point_budget;
+#ifdef _MSC_VER
+	char* value = nullptr;
+	size_t len = 0;
+	if (_dupenv_s(&value, &len, point_budget_env) == 0 && value)
+	{
+		budget = atoi(value);
+		free(value);
+	}
+#else
+	if (const char* value = getenv(point_budget_env))
+		budget = atoi(value);
+#endif
+	return (budget < 2) ? 2 : budget;
+}
+
 tresult PLUGIN_API Smoothie::setupProcessing(ProcessSetup& newSetup)
 {
 	LOG("Smoothie::setupProcessing called.\n");
-	processContextRequirements.flags = 0;
+	processContextRequirements.flags = IProcessContextRequirements::kNeedTempo;  // for tempo-synced triads
 	tresult result = AudioEffect::setupProcessing(newSetup);
+
+	// Preallocate the engine's per-triad input and output storage so that process() never allocates.
+	// Each triad emits at most one CC event per sample, so a block never needs more than maxSamplesPerBlock
+	// CC entries per triad.  Storage for that many is allocated unless the host announces blocks longer than
+	// max_staged_cc_events samples; CC events lost to a block that outgrows the storage anyway are counted
+	// (PerfDroppedCC).  Incoming curves are decimated to the point budget, which bounds both the incoming
+	// storage and the work done per block.
+	if (result == kResultOk)
+	{
+		const size_t capacity = (processSetup.maxSamplesPerBlock <= 0) ? 0 :
+			(processSetup.maxSamplesPerBlock < max_staged_cc_events) ? processSetup.maxSamplesPerBlock : max_staged_cc_events;
+		point_budget = get_point_budget();
+		SmootherInput full_block;
+		full_block.in.count = full_block.out.count = full_block.slowness.count = full_block.fall_slowness.count = point_budget;
+		for (ParamID i = 0; i < num_smoothed_params; ++i)
+		{
+			for (ParamID j = 0; j < NumParamOffsets; ++j)
+				in_points[i][j].resize(point_budget);
+			fall_points[i].resize(point_budget);
+			out_points[i].resize(max_output_points(full_block));
+			staged_cc[i].resize(capacity);
+			block_out[i].cc_count = 0;
+		}
+	}
+
 	LOG("Smoothie::setupProcessing exited with code %d.\n", result);
 	return result;
 }
@@ -140,15 +274,6 @@ tresult PLUGIN_API Smoothie::getRoutingInfo(RoutingInfo& inInfo, RoutingInfo& ou
 	}
 }
 
-constexpr double small_double = 0.00001;
-static inline bool roughly_equal(ParamValue x, ParamValue y)
-{
-	ParamValue diff = x - y;
-	return (-small_double <= diff) && (diff <= small_double);
-}
-
-#define CONSTRAIN(var) if ((var) < 0.) (var) = 0.; else if ((var) > 1.) (var) = 1.
-
 static void output_initial_point(IParameterChanges* out_changes, ParamID id, ParamValue y)
 {
 	int32 dummy;
@@ -170,104 +295,104 @@ static void output_initial_point(IParameterChanges* out_changes, ParamID id, Par
 		q->addPoint(0, y, dummy);
 }
 
-void Smoothie::addOutPoint(ProcessData& data, IParamValueQueue*& pqueue, int32 param_set, int32 firstSampleOffset, int32 finalSampleOffset, int8& prevCCval, double finalval)
+// Copy a host-provided automation curve into preallocated storage, and point the engine's span at it.
+// A curve with more points than the storage holds is decimated as it is read (see read_decimated), so a
+// misbehaving host can't make a block take longer than the point budget allows.  Points whose value is not
+// a number are skipped too.  Returns the number of points skipped.
+static int32 read_curve(IParamValueQueue* q, std::vector<CurvePoint>& storage, CurveSpan& span)
 {
-	if (data.outputParameterChanges)
-	{
-		int32 dummy;
-		if (!pqueue)
-			pqueue = data.outputParameterChanges->addParameterData(param_set * NumParamOffsets + OutParamOffset, dummy);
-		if (pqueue)
-			pqueue->addPoint(finalSampleOffset, finalval, dummy);
-	}
-	values[param_set].out = finalval;
+	int32 n = q ? q->getPointCount() : 0;
+	if (n < 0) n = 0; // should never happen (host served invalid point count)
+	if (n > 0 && storage.size() < 2)
+		storage.resize(2); // should never happen (storage preallocated by setupProcessing)
+
+	const int32 count = read_decimated(n, (int32)storage.size(), storage.data(),
+		[q](int32 i, CurvePoint& p) { return q->getPoint(i, p.offset, p.value) == kResultOk; });
+	span.points = storage.data();
+	span.count = count;
+	return n - count;
+}
 
-	const int8 firstCCval = prevCCval;
-	int8 finalCCval = std::round(127. * finalval);
-	if (finalCCval < 0) finalCCval = 0; else if (finalCCval > 127) finalCCval = 127;
+// Final value of a toggle parameter's curve in this block, or current if the curve has no points
+static bool read_toggle(IParamValueQueue* q, bool current)
+{
+	int32 n = q ? q->getPointCount() : 0;
+	int32 offset;
+	ParamValue value;
+	if (n > 0 && q->getPoint(n - 1, offset, value) == kResultOk)
+		return value >= .5;
+	return current;
+}
 
-	if (finalCCval != firstCCval && data.outputEvents)
+// Emit all of this block's events to the host as a single stream sorted by sampleOffset:  a k-way merge of
+// the incoming events (MIDI thru) with each triad's CC changes.  Each input stream is already in time
+// order, and ties are broken in favor of thru events first, then lower-numbered triads.
+void Smoothie::flushEvents(ProcessData& data)
+{
+	const int32 numThru = (data.inputEvents && data.outputEvents) ? data.inputEvents->getEventCount() : 0;
+	int32 thru_index = 0;
+	Event thru_event = {};
+	bool have_thru = false;
+	while (!have_thru && thru_index < numThru)
+		have_thru = (data.inputEvents->getEvent(thru_index++, thru_event) == kResultOk);
+
+	int32 cc_index[num_smoothed_params] = {};
+	while (data.outputEvents)
 	{
-		Event e = {};
-		e.type = e.kLegacyMIDICCOutEvent;
-		e.midiCCOut.controlNumber = cc + param_set;
+		int32 best_offset = have_thru ? thru_event.sampleOffset : INT32_MAX;
+		int32 best_set = -1;
+		for (ParamID i = 0; i < num_smoothed_params; ++i)
+			if (cc_index[i] < block_out[i].cc_count && block_out[i].cc[cc_index[i]].offset < best_offset)
+			{
+				best_offset = block_out[i].cc[cc_index[i]].offset;
+				best_set = i;
+			}
 
-		if (finalSampleOffset <= firstSampleOffset)
+		if (best_set >= 0)
 		{
-			e.sampleOffset = finalSampleOffset;
-			e.midiCCOut.value = prevCCval = finalCCval;
+			const CCChange& change = block_out[best_set].cc[cc_index[best_set]++];
+			Event e = {};
+			e.type = e.kLegacyMIDICCOutEvent;
+			e.sampleOffset = change.offset;
+			e.midiCCOut.controlNumber = cc + best_set;
+			e.midiCCOut.value = (int8)change.value;
 			data.outputEvents->addEvent(e);
 		}
-		else
+		else if (have_thru)
 		{
-			const int32 xrange = finalSampleOffset - firstSampleOffset;
-			const int32 yrange = (int32)finalCCval - (int32)firstCCval;
-			const double slope = (double)yrange / (double)xrange;
-
-			if (slope >= 0.5 || slope <= -0.5)
-			{
-				for (int32 i = 1; i <= xrange; ++i)
-				{
-					int32 y = firstCCval + (int32)std::round((double)i * slope);
-					if (y < 0) y = 0; else if (y > 127) y = 127;
-					if (y != prevCCval)
-					{
-						e.sampleOffset = firstSampleOffset + i;
-						e.midiCCOut.value = prevCCval = (int8)y;
-						data.outputEvents->addEvent(e);
-					}
-				}
-			}
-			else
-			{
-				const int8 ysign = (firstCCval <= finalCCval) ? 1 : -1;
-				for (int8 y = firstCCval; y != finalCCval; )
-				{
-					y += ysign;
-					const int32 x = firstSampleOffset + (int32)std::round((double)(y - (int32)firstCCval) / slope);
-					if (x > firstSampleOffset)
-					{
-						e.sampleOffset = (x >= finalSampleOffset) ? finalSampleOffset : x;
-						e.midiCCOut.value = y;
-						data.outputEvents->addEvent(e);
-					}
-				}
-			}
+			data.outputEvents->addEvent(thru_event);
+			have_thru = false;
+			while (!have_thru && thru_index < numThru)
+				have_thru = (data.inputEvents->getEvent(thru_index++, thru_event) == kResultOk);
 		}
+		else
+			break;
 	}
 
-	prevCCval = finalCCval;
+	for (ParamID i = 0; i < num_smoothed_params; ++i)
+		block_out[i].cc_count = 0;
 }
 
-static ParamValue interpolate(int32 x0, ParamValue y0, int32 x1, ParamValue y1, int32 x)
+tresult PLUGIN_API Smoothie::process(ProcessData& data)
 {
-	if (x1 == x0)
-	{
-		if (y1 == y0)
-			return y0;
-		else if (x == x0)
-			return y1;
-		else if (y1 > y0)
-			return (x > x1) ? 1. : 0.;
-		else
-			return (x > x1) ? 0. : 1.;
-	}
-	else
-	{
-		ParamValue y = (ParamValue)(x - x0) / (ParamValue)(x1 - x0) * (y1 - y0) + y0;
-		CONSTRAIN(y);
-		return y;
-	}
+	const uint64 start = perf_cycles();
+	tresult result = processBlock(data);
+	perf.recordBlock(perf_cycles() - start);
+	return result;
 }
 
-tresult PLUGIN_API Smoothie::process(ProcessData& data)
+tresult Smoothie::processBlock(ProcessData& data)
 {
-	if (!data.processContext || data.processContext->sampleRate <= 0. || data.numSamples < 0)
+	if (!data.processContext || !(data.processContext->sampleRate > 0.) || data.numSamples < 0)
 	{
 		LOG("Smoothie::process aborted due to bad sample rate provided by host.\n");
 		return kResultFalse;
 	}
 
+	applyIncomingState();
+	if ((data.processContext->state & ProcessContext::kTempoValid) && data.processContext->tempo > 0.)
+		tempo = data.processContext->tempo;
+
 	// We shouldn't be asked for any audio, but process it anyway (emit silence) to tolerate uncompliant hosts.
 	const bool is32bit = (data.symbolicSampleSize == kSample32);
 	const size_t buffersize = data.numSamples * ((data.symbolicSampleSize == kSample32) ? sizeof(Sample32) : sizeof(Sample64));
@@ -286,6 +411,7 @@ tresult PLUGIN_API Smoothie::process(ProcessData& data)
 
 	// Organize host-provided incoming parameter change queues into arrays.
 	IParamValueQueue* in_queue[num_smoothed_params][NumParamOffsets] = {};
+	IParamValueQueue* extra_queue[num_smoothed_params][NumExtraParamOffsets] = {};
 	if (data.inputParameterChanges)
 	{
 		int32 numParamsChanged = data.inputParameterChanges->getParameterCount();
@@ -293,26 +419,44 @@ tresult PLUGIN_API Smoothie::process(ProcessData& data)
 		{
 			IParamValueQueue* q = data.inputParameterChanges->getParameterData(i);
 			ParamID id = q->getParameterId();
-			if (id < num_smoothed_params * NumParamOffsets)
+			if (id < extra_params_base)
 				in_queue[id / NumParamOffsets][id % NumParamOffsets] = q;
+			else if (id < num_params)
+				extra_queue[(id - extra_params_base) / NumExtraParamOffsets][(id - extra_params_base) % NumExtraParamOffsets] = q;
 		}
 	}
 
+	// Hand each triad's incoming automation curves to the smoothing engine.
+	SmootherInput inputs[num_smoothed_params];
+	for (ParamID i = 0; i < num_smoothed_params; ++i)
+	{
+		int32 dropped = read_curve(in_queue[i][InParamOffset], in_points[i][InParamOffset], inputs[i].in);
+		dropped += read_curve(in_queue[i][OutParamOffset], in_points[i][OutParamOffset], inputs[i].out);
+		dropped += read_curve(in_queue[i][SlownessOffset], in_points[i][SlownessOffset], inputs[i].slowness);
+		dropped += read_curve(extra_queue[i][FallSlownessOffset], fall_points[i], inputs[i].fall_slowness);
+		if (dropped > 0)
+			perf.add(PerfDroppedPoints + i, dropped);
+		perf.add(PerfInPoints + i * NumParamOffsets + InParamOffset, inputs[i].in.count);
+		perf.add(PerfInPoints + i * NumParamOffsets + OutParamOffset, inputs[i].out.count);
+		perf.add(PerfInPoints + i * NumParamOffsets + SlownessOffset, inputs[i].slowness.count + inputs[i].fall_slowness.count);
+
+		// Thin out dense automation before smoothing it (OutParam points are overrides, so they are kept as-is).
+		inputs[i].in.count = simplify_ramps(in_points[i][InParamOffset].data(), inputs[i].in.count, default_ramp_tolerance);
+		inputs[i].slowness.count = simplify_steps(in_points[i][SlownessOffset].data(), inputs[i].slowness.count);
+		inputs[i].fall_slowness.count = simplify_steps(fall_points[i].data(), inputs[i].fall_slowness.count);
+
+		// Mode switches take effect for the whole block in which they arrive.
+		values[i].separate_fall = read_toggle(extra_queue[i][SeparateFallOffset], values[i].separate_fall);
+		values[i].tempo_sync = read_toggle(extra_queue[i][TempoSyncOffset], values[i].tempo_sync);
+	}
+
 	// If the host wants to flush parameters without processing, do so and exit.
 	if (data.numSamples <= 0)
 	{
-		for (ParamID i = 0; i < num_smoothed_params; ++i)
-			for (ParamID j = 0; j < NumParamOffsets; ++j)
-				if (IParamValueQueue* q = in_queue[i][j])
-				{
-					const int32 n = q->getPointCount();
-					if (n > 0)
-					{
-						ParamValue* y = (j == InParamOffset) ? &values[i].in : (j == OutParamOffset) ? &values[i].out : &values[i].slowness;
-						int32 dummy;
-						q->getPoint(n - 1, dummy, *y);
-					}
-				}
+		smooth_blocks(num_smoothed_params, values, inputs, 0, data.processContext->sampleRate, block_out, tempo);
+		updateTail(data.processContext->sampleRate);
+		publishState();
+		flushEvents(data);
 		return kResultOk;
 	}
 
@@ -331,263 +475,69 @@ tresult PLUGIN_API Smoothie::process(ProcessData& data)
 		}
 	}
 
-	/* Begin sample-accurate processing of InParam -> OutParam smoothing:
-	 * 
-	 * slowness=0 -> changes to InParam are instantly reflected to OutParam
-	 * slowness=.5 -> changes to InParam cause OutParam to move at a rate of secs_per_half_slowness toward InParam
-	 * slowness=1 -> changes to InParam cause OutParam to react infinitely slowly (OutParam never changes)
-	 *
-	 * In general, to make OutParam take n seconds to move from 0 to 1, set slowness to:
-	 *   slowness = n / (n + h)
-	 * where h = secs_per_half_slowness (default=2)
-	 */
+	// Smooth all triads over this block.
+	ParamValue saved_original_outval[num_smoothed_params];
+	for (ParamID i = 0; i < num_smoothed_params; ++i)
+	{
+		saved_original_outval[i] = values[i].out;
+		const int32 n = max_output_points(inputs[i]);
+		if ((size_t)n > out_points[i].size())
+			out_points[i].resize(n); // should never happen (storage preallocated for a full block)
+		block_out[i].points = out_points[i].data();
+		block_out[i].point_capacity = n;
+		block_out[i].cc = data.outputEvents ? staged_cc[i].data() : nullptr;
+		block_out[i].cc_capacity = (int32)staged_cc[i].size();
+	}
+	smooth_blocks(num_smoothed_params, values, inputs, data.numSamples, data.processContext->sampleRate, block_out, tempo);
 
 	for (ParamID param_set = 0; param_set < num_smoothed_params; ++param_set)
 	{
-		IParamValueQueue* const* const in_q = in_queue[param_set];
-		const ParamValue saved_original_outval = values[param_set].out;
-
-		// (in_x0,in_y0)--(in_x1,in_y1) is the last processed segment in InParam's automation curve,
-		// and in_index is the index of the next point in its curve.
-		int32 in_x0 = -1;
-		ParamValue in_y0 = values[param_set].in;
-		int32 in_x1 = -1;
-		ParamValue in_y1 = in_y0;
-		int32 in_index = 0;
-
-		// (slowness_x,slowness) is the last processed point in Slowness's automation curve,
-		// and slowness_index is the index of the next point in its curve.
-		int32 slowness_x = -1;
-		ParamValue slowness = values[param_set].slowness;
-		int32 slowness_index = 0;
-
-		// lastCC is the most recent CC value output for OutParam
-		int8 lastCC = std::round(127. * values[param_set].out);
-
-		// Count the number points in each parameter's incoming automation curve.
-		int32 numPoints[NumParamOffsets] = {};
-		for (ParamID i = 0; i < NumParamOffsets; ++i)
-			if (in_q[i])
-			{
-				numPoints[i] = in_q[i]->getPointCount();
-				if (numPoints[i] < 0) numPoints[i] = 0; // should never happen (host served invalid point count)
-			}
-
-		// (out_x0,out_y0) = the last OutParam automation curve point that was output.
-		// (The point at offset -1 was implicitly output by the last call to process().)
-		// Invariant: in_x0 <= out_x0
-		int32 out_x0 = -1;
-		ParamValue out_y0 = values[param_set].out;
-		for (int32 out_index = 0; (uint32)out_index <= (uint32)numPoints[OutParamOffset]; ++out_index)
+		const SmootherOutput& result = block_out[param_set];
+		perf.add(PerfOverrides + param_set, result.overrides);
+		perf.add(PerfCCEvents + param_set, result.cc_count);
+		if (result.cc_dropped > 0)
+			perf.add(PerfDroppedCC + param_set, result.cc_dropped);
+
+		// Send the smoothed OutParam curve to the host.
+		if (data.outputParameterChanges && result.point_count > 0)
 		{
-			int32 out_x1 = data.numSamples - 1;
-			ParamValue out_y1 = out_y0;
-			if (out_index < numPoints[OutParamOffset])
-			{
-				in_q[OutParamOffset]->getPoint(out_index, out_x1, out_y1);
-				if (out_x1 >= data.numSamples) out_x1 = data.numSamples - 1; // should never happen (host served invalid point queue)
-				CONSTRAIN(out_y1);
-			}
-			if (out_x1 <= out_x0)
-			{
-				// should never happen (host served invalid point queue)
-				out_y0 = out_y1;
-				continue;
-			}
-			else if (!roughly_equal(out_y0, out_y1))
-			{
-				// The received curve for OutParam changed it over interval (out_x0, out_x1],
-				// overriding any smoothing, so output that segment as-received.
-				addOutPoint(data, out_queue[param_set], param_set, out_x0, out_x1, lastCC, out_y1);
-				out_x0 = out_x1;
-				out_y0 = out_y1;
-				continue;
-			}
-			// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
-
-			// The received curve for OutParam didn't change (much) over interval (out_x0, out_x1].
-			// Merge all consecutive segments that don't change it (much) until we reach a segment
-			// that does change it, or we reach the end of the sample buffer.
-			while (out_index < numPoints[OutParamOffset])
-			{
-				int32 out_x2 = data.numSamples - 1;
-				ParamValue out_y2 = out_y1;
-				if (out_index + 1 < numPoints[OutParamOffset])
-					in_q[OutParamOffset]->getPoint(out_index + 1, out_x2, out_y2);
-				CONSTRAIN(out_y2);
-				if (!roughly_equal(out_y1, out_y2))
-					break;
-				++out_index;
-				if (out_x2 >= data.numSamples) out_x2 = data.numSamples - 1; // should never happen (host served invalid point queue)
-				if (out_x1 < out_x2) out_x1 = out_x2; // should always happen (otherwise host served invalid point queue)
-				out_y1 = out_y2;
-			}
-			// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
-
-			// OutParam is unchanging over interval (out_x0, out_x1], and out_x1 is either the
-			// start of a host-overridden segment or the end of the sample buffer (numSamples - 1).
-			// Proceed to smoothly migrate OutParam toward InParam over interval (out_x0, out_x1]...
-
-			while (out_x0 < out_x1)
+			int32 dummy;
+			IParamValueQueue*& pqueue = out_queue[param_set];
+			if (!pqueue)
+				pqueue = data.outputParameterChanges->addParameterData(param_set * NumParamOffsets + OutParamOffset, dummy);
+			if (pqueue)
 			{
-				// Find the first segment of InParam's automation curve that ends strictly after out_x0
-				// Invariant: in_x0 <= out_x0 < out_x1 < numSamples
-				while (in_x1 <= out_x0)
-				{
-					in_x0 = in_x1;
-					in_y0 = in_y1;
-					if (in_index < numPoints[InParamOffset])
-					{
-						in_q[InParamOffset]->getPoint(in_index, in_x1, in_y1);
-						if (in_x1 < in_x0) in_x1 = in_x0; // should never happen (host served invalid point queue)
-						else if (in_x1 >= data.numSamples) in_x1 = data.numSamples - 1; // should never happen (host served invalid point queue)
-						++in_index;
-						CONSTRAIN(in_y1);
-					}
-					else
-					{
-						in_x1 = data.numSamples - 1;
-						break;
-					}
-				}
-				// Postcondition: in_x0 <= out_x0 < in_x1 < numSamples
-				// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
-
-				// Find the first point of Slowness's automation curve that is strictly after out_x0
-				while (slowness_x <= out_x0)
-				{
-					if (slowness_index < numPoints[SlownessOffset])
-					{
-						in_q[SlownessOffset]->getPoint(slowness_index, slowness_x, slowness);
-						++slowness_index;
-						if (slowness_x >= data.numSamples) slowness_x = data.numSamples - 1; // should never happen (host served invalid point queue)
-						CONSTRAIN(slowness);
-					}
-					else
-					{
-						slowness_x = data.numSamples - 1;
-						break;
-					}
-				}
-				// Postcondition: out_x0 < slowness_x < numSamples
-				// Postcondition: in_x0 <= out_x0 < in_x1 < numSamples
-				// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
-
-				// Let x be the first sample offset within (out_x0,out_x1] where InParam or Slowness changes
-				// (or let x = out_x1 if neither changes anywhere within that interval).
-				int32 x = (in_x1 <= slowness_x) ? in_x1 : slowness_x;
-				if (x > out_x1) x = out_x1;
-				// Postcondition: out_x0 < x <= out_x1 < numSamples
-
-				// Prepare to output a new OutParam automation curve point at x...
-				// Note:  in_x1 - in_x0 > 0 because in_x0 <= out_x0 < in_x1
-				ParamValue max_slope =
-					(slowness <= 0.) ? 1. : ((1. - slowness) / slowness / secs_per_half_slowness / data.processContext->sampleRate);
-				const ParamValue in_slope = (in_y1 - in_y0) / (ParamValue)(in_x1 - in_x0);
-				in_y0 = interpolate(in_x0, in_y0, in_x1, in_y1, out_x0);
-				in_x0 = out_x0;
-				ParamValue param_diff = in_y0 - out_y0;
-				if (param_diff < 0.)
-					param_diff = -param_diff;
-				ParamValue out_slope, y;
-
-				// If OutParam can catch the InParam's automation curve (without exceeding speed max_slope) before x,
-				// output an extra automation curve point for OutParam at the intersection point of the two curves.
-				// Otherwise move it toward InParam at its max allowed speed.
-				if (param_diff > small_double)
-				{
-					out_slope = (in_y0 > out_y0) ? max_slope : -max_slope;
-					const int32 intersection_x = (in_slope == out_slope) ? -1
-						: (out_x0 + (int32)std::round((in_y0 - out_y0) / (out_slope - in_slope)));
-					if (out_x0 < intersection_x && intersection_x < x)
-					{
-						ParamValue intersection_y = in_y0 + in_slope * (ParamValue)(intersection_x - out_x0);
-						CONSTRAIN(intersection_y);
-						addOutPoint(data, out_queue[param_set], param_set, out_x0, intersection_x, lastCC, intersection_y);
-						out_x0 = in_x0 = intersection_x;
-						out_y0 = in_y0 = intersection_y;
-						param_diff = 0.;
-					}
-					else
-					{
-						y = out_y0 + out_slope * (ParamValue)(x - out_x0);
-					}
-				}
-
-				// If OutParam has already reached InParam, make it follow InParam's movement up to its max allowed speed.
-				if (param_diff <= small_double)
-				{
-					if (in_slope < -max_slope)
-					{
-						out_slope = -max_slope;
-						y = in_y0 + out_slope * (ParamValue)(x - out_x0);
-					}
-					else if (in_slope <= max_slope)
-					{
-						out_slope = in_slope;
-						y = interpolate(in_x0, in_y0, in_x1, in_y1, x);
-					}
-					else
-					{
-						out_slope = max_slope;
-						y = in_y0 + out_slope * (ParamValue)(x - out_x0);
-					}
-				}
-
-				CONSTRAIN(y);
-
-				// Output the computed automation curve point for OutParam (but omit it if it's at the
-				// end of a flat segment of the curve at the end of the buffer, as per the VST3 standard).
-				if (!(x >= data.numSamples - 1 && roughly_equal(out_y0, y)))
-					addOutPoint(data, out_queue[param_set], param_set, out_x0, x, lastCC, y);
-
-				// Shift out_x0 forward to the most recently outputted point, and continue until the
-				// end of the non-overridden OutParam segment is reached.
-				out_x0 = x;
-				out_y0 = y;
+				for (int32 i = 0; i < result.point_count; ++i)
+					pqueue->addPoint(result.points[i].offset, result.points[i].value, dummy);
+				perf.add(PerfOutPoints + param_set, result.point_count);
 			}
-			// Postcondition: out_x0 == out_x1
-
-			// Point (out_x1, ?) is the boundary between the end of a VST-generated smoothed curve and a
-			// host-generated segment that overrides the VST's curve.  For best smoothing, we interpret
-			// this point as having y-value equal to the VST-generated smoothed curve's value, so that the
-			// overridden segment starts as a 0% override and linearly progresses to a 100% override by
-			// the end of the overridden segment.  When the override is a jump in the curve (common case),
-			// this preserves the jump; but when the override is a gradual change (e.g., introduced by
-			// host automation), this replaces the overridden segment with a smooth transition from the
-			// VST-generated smoothed segment's end to the host-generated overridden segment's end.
-			out_y1 = out_y0;
-
-			// Now continue with the next segment (if any) of the incoming OutParam automation curve
-			// (which will always be an overridden segment if we got this far in the loop body)...
 		}
 
 		// Force-output points at sample offset 0 on the first call to process(), to help hosts
 		// synchronize their parameters with the VST's after a load/restore of plug-in state.
 		if (!initial_points_sent && data.outputParameterChanges)
 		{
-			output_initial_point(data.outputParameterChanges, param_set * NumParamOffsets + OutParamOffset, saved_original_outval);
-			if (numPoints[InParamOffset] <= 0)
+			output_initial_point(data.outputParameterChanges, param_set * NumParamOffsets + OutParamOffset, saved_original_outval[param_set]);
+			if (inputs[param_set].in.count <= 0)
 				output_initial_point(data.outputParameterChanges, param_set * NumParamOffsets + InParamOffset, values[param_set].in);
-			if (numPoints[SlownessOffset] <= 0)
+			if (inputs[param_set].slowness.count <= 0)
 				output_initial_point(data.outputParameterChanges, param_set * NumParamOffsets + SlownessOffset, values[param_set].slowness);
-		}
-
-		// Update the stored values of InParam and Slowness for use by the next call to process().
-		if (numPoints[InParamOffset] > 0)
-		{
-			int32 dummy;
-			in_q[InParamOffset]->getPoint(numPoints[InParamOffset] - 1, dummy, values[param_set].in);
-		}
-		if (numPoints[SlownessOffset] > 0)
-		{
-			int32 dummy;
-			in_q[SlownessOffset]->getPoint(numPoints[SlownessOffset] - 1, dummy, values[param_set].slowness);
+			const ParamID extra = extra_params_base + param_set * NumExtraParamOffsets;
+			if (inputs[param_set].fall_slowness.count <= 0)
+				output_initial_point(data.outputParameterChanges, extra + FallSlownessOffset, values[param_set].fall_slowness);
+			if (!extra_queue[param_set][SeparateFallOffset])
+				output_initial_point(data.outputParameterChanges, extra + SeparateFallOffset, values[param_set].separate_fall ? 1. : 0.);
+			if (!extra_queue[param_set][TempoSyncOffset])
+				output_initial_point(data.outputParameterChanges, extra + TempoSyncOffset, values[param_set].tempo_sync ? 1. : 0.);
 		}
 	}
 
 	if (data.outputParameterChanges)
 		initial_points_sent = true;
 
+	updateTail(data.processContext->sampleRate);
+	publishState();
+	flushEvents(data);
+
 	return kResultOk;
-}
+}
\ No newline at end of file
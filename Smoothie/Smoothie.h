@@ -8,12 +8,15 @@
 #include "base/source/fstring.h"
 #include "pluginterfaces/base/funknown.h"
 #include <pluginterfaces/vst/ivstparameterchanges.h>
+#include "pluginterfaces/vst/ivstmessage.h"
+#include <vector>
+
+#include "SmoothieEngine.h"
 
 using namespace Steinberg;
 using namespace Steinberg::Vst;
 
 constexpr Steinberg::Vst::ParamID num_smoothed_params = 8;
-constexpr double secs_per_half_slowness = 2;  // seconds to go from 0 to 1 when slowness = .5
 
 // Parameter enumeration
 enum SmoothieParamOffsets : Steinberg::Vst::ParamID
@@ -24,19 +27,37 @@ enum SmoothieParamOffsets : Steinberg::Vst::ParamID
 	NumParamOffsets = 3,
 };
 
+// Further parameters of each triad, numbered after all triads' original parameters so that existing
+// parameter IDs (and the automation hosts have recorded for them) are unchanged.  The parameter with
+// offset j of triad i has ID extra_params_base + i * NumExtraParamOffsets + j.
+enum SmoothieExtraParamOffsets : Steinberg::Vst::ParamID
+{
+	FallSlownessOffset = 0,
+	SeparateFallOffset = 1,  // toggle:  limit falls by FallSlowness instead of Slowness
+	TempoSyncOffset = 2,  // toggle:  Slowness and FallSlowness are in beats instead of seconds
+	NumExtraParamOffsets = 3,
+};
+
+constexpr Steinberg::Vst::ParamID extra_params_base = num_smoothed_params * NumParamOffsets;
+constexpr Steinberg::Vst::ParamID num_params = extra_params_base + num_smoothed_params * NumExtraParamOffsets;
+
+constexpr int32 max_staged_cc_events = 65536;  // per-triad cap on preallocated outgoing CC event storage (samples per block)
+constexpr const char* point_budget_env = "SMOOTHIE_POINT_BUDGET";  // if set, overrides default_point_budget
+
 constexpr uint8 cc = 90;
 #if cc + num_smoothed_params > 127
 #  error "Not enough CC slots for smoothed params."
 #endif
 
+#include "PerfCounters.h"
+#include "SeqLock.h"
+
 // Plugin processor GUID - must be unique
 static const FUID SmoothieProcessorUID(0xbe1df3c4, 0x903a464c, 0xbc64cea7, 0xa2059f4f);
 
-typedef struct param_set {
-	ParamValue in = 0;
-	ParamValue out = 0;
-	ParamValue slowness = .5;
-} ParamSet;
+typedef struct state_snapshot {
+	ParamSet values[num_smoothed_params];
+} StateSnapshot;
 
 class Smoothie : public AudioEffect
 {
@@ -59,12 +80,30 @@ public:
 	tresult PLUGIN_API setState(IBStream* state);
 	tresult PLUGIN_API getState(IBStream* state);
 	tresult PLUGIN_API canProcessSampleSize(int32 symbolicSampleSize);
+	tresult PLUGIN_API notify(IMessage* message);
+	uint32 PLUGIN_API getTailSamples();
 	~Smoothie(void);
 
 protected:
-	ParamSet values[num_smoothed_params];
+	ParamSet values[num_smoothed_params];  // owned by the audio thread; other threads go through the state exchanges below
 	bool initial_points_sent = false;
-	void addOutPoint(ProcessData& data, IParamValueQueue*& pqueue, int32 param_set, int32 firstSampleOffset, int32 finalSampleOffset, int8& prevCCval, double finalval);
+	SeqLock<StateSnapshot> incoming_state;  // written by setState, applied by the audio thread at the next block boundary
+	SeqLock<StateSnapshot> published_state;  // written by the audio thread after each block, read by getState
+	std::atomic<uint32> applied_state_version{0};  // version of incoming_state most recently applied by the audio thread
+	std::atomic<uint32> tail_samples{0};  // samples until every OutParam converges, as of the end of the last block
+	PerfCounters perf;
+	int32 point_budget = default_point_budget;  // most points read from each incoming curve per block (set by setupProcessing)
+	double tempo = default_tempo;  // host tempo as of the last block that reported one
+	std::vector<CurvePoint> in_points[num_smoothed_params][NumParamOffsets];  // incoming curves handed to the engine
+	std::vector<CurvePoint> fall_points[num_smoothed_params];  // incoming FallSlowness curves handed to the engine
+	std::vector<CurvePoint> out_points[num_smoothed_params];  // smoothed OutParam curves produced by the engine
+	std::vector<CCChange> staged_cc[num_smoothed_params];  // each triad's CC changes for this block, in time order
+	SmootherOutput block_out[num_smoothed_params];  // engine output spans over out_points and staged_cc
+	void flushEvents(ProcessData& data);
+	tresult processBlock(ProcessData& data);
+	void applyIncomingState(void);
+	void publishState(void);
+	void updateTail(double sampleRate);
 };
 
 #ifdef LOGGING
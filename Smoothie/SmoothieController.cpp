@@ -1,11 +1,61 @@
 #include "pluginterfaces/base/ibstream.h"
 #include "base/source/fstreamer.h"
 #include <pluginterfaces/vst/ivstmidicontrollers.h>
+#include "pluginterfaces/vst/ivstmessage.h"
 
 #include "Smoothie.h"
 #include "SmoothieController.h"
-#include <string>
-#include <pluginterfaces/base/ustring.h>
+#include "SmoothieState.h"
+#include <cstring>
+#include <cmath>
+#include <utility>
+
+constexpr ParamValue max_finite_slowness_secs = 24.0 * 60.0 * 60.0;  // larger slowness values display as infinity
+
+static void uint32_to_str16(TChar* p, uint32 n)
+{
+	if (n == 0)
+	{
+		*p++ = u'0';
+		*p = 0;
+	}
+	else
+	{
+		uint32 width = 0;
+		for (uint32 i = n; i; i /= 10)
+			++width;
+
+		*(p + width) = 0;
+		for (uint32 i = n; width > 0; i /= 10)
+			*(p + --width) = STR16("0123456789")[i % 10];
+	}
+}
+
+// Write a non-negative value with the given number of decimal places followed by a one-character suffix.
+// Unlike UString::printFloat, this doesn't go through the C runtime's formatted output.
+static void fixed_to_str16(TChar* p, ParamValue value, int32 precision, TChar suffix)
+{
+	uint32 scale = 1;
+	for (int32 i = 0; i < precision; ++i)
+		scale *= 10;
+	const uint64 scaled = (uint64)std::llround(value * scale);
+
+	uint32_to_str16(p, (uint32)(scaled / scale));
+	while (*p) ++p;
+	if (precision > 0)
+	{
+		*p++ = u'.';
+		uint32 frac = (uint32)(scaled % scale);
+		for (int32 i = precision; i > 0; --i)
+		{
+			p[i - 1] = STR16("0123456789")[frac % 10];
+			frac /= 10;
+		}
+		p += precision;
+	}
+	*p++ = suffix;
+	*p = 0;
+}
 
 SmoothnessParam::SmoothnessParam(void)
 {
@@ -48,12 +98,13 @@ ParamValue SmoothnessParam::toNormalized(ParamValue plainValue) const
 
 void SmoothnessParam::toString(ParamValue normValue, String128 string) const
 {
+	const bool beats = tempo_sync && tempo_sync->getNormalized() >= .5;
 	if (normValue <= 0.0)
 	{
 		string[0] = '0';
 		string[1] = 0;
 	}
-	else if (normValue >= toNormalized(24.0 * 60.0 * 60.0))
+	else if (normValue >= toNormalized(max_finite_slowness_secs))
 	{
 		string[0] = u'\u221E';
 		string[1] = 0;
@@ -62,27 +113,23 @@ void SmoothnessParam::toString(ParamValue normValue, String128 string) const
 	{
 		ParamValue plainValue = toPlain(normValue);
 		ParamValue printedValue = plainValue;
-		TChar suffix[2] = {};
-		if (plainValue >= 60.0 * 60.0)
+		TChar suffix;
+		if (beats)
+			suffix = u'b';
+		else if (plainValue >= 60.0 * 60.0)
 		{
-			suffix[0] = u'h';
+			suffix = u'h';
 			printedValue /= 60.0 * 60.0;
 		}
 		else if (plainValue >= 60.0)
 		{
-			suffix[0] = u'm';
+			suffix = u'm';
 			printedValue /= 60.0;
 		}
 		else
-			suffix[0] = u's';
+			suffix = u's';
 
-		UString wrapper(string, str16BufferSize(String128));
-		if (wrapper.printFloat(printedValue, precision))
-		{
-			wrapper.append(suffix, 2);
-		}
-		else
-			string[0] = 0;
+		fixed_to_str16(string, printedValue, precision, suffix);
 	}
 }
 
@@ -125,34 +172,39 @@ SmoothieController::SmoothieController(void)
 
 SmoothieController::~SmoothieController(void)
 {
-	LOG("SmoothieController destructor called and exited.\n");
+	LOG("SmoothieController destructor called.\n");
+	releasePools();
+	LOG("SmoothieController destructor exited.\n");
 }
 
-tresult PLUGIN_API SmoothieController::queryInterface(const char* iid, void** obj)
+// Construct an object at the end of a pool, or return nullptr if the pool is full.  Pools never grow, since
+// growing would move the objects that units and parameters already hold pointers to.
+template <class T, class... Args>
+static T* add_to_pool(std::vector<T>& pool, Args&&... args)
 {
-	QUERY_INTERFACE(iid, obj, IMidiMapping::iid, IMidiMapping)
-	return EditControllerEx1::queryInterface(iid, obj);
+	if (pool.size() >= pool.capacity())
+		return nullptr;
+	pool.emplace_back(std::forward<Args>(args)...);
+	return &pool.back();
 }
 
-static void uint32_to_str16(TChar* p, uint32 n)
+// Drop all references to the pooled units and parameters, then free the pools.
+void SmoothieController::releasePools(void)
 {
-	if (n == 0)
-	{
-		*p++ = u'0';
-		*p = 0;
-	}
-	else
-	{
-		uint32 width = 0;
-		for (uint32 i = n; i; i /= 10)
-			++width;
+	parameters.removeAll();
+	units.clear();
+	unit_pool.clear();
+	param_pool.clear();
+	slowness_pool.clear();
+}
 
-		*(p + width) = 0;
-		for (uint32 i = n; width > 0; i /= 10)
-			*(p + --width) = STR16("0123456789")[i % 10];
-	}
+tresult PLUGIN_API SmoothieController::queryInterface(const char* iid, void** obj)
+{
+	QUERY_INTERFACE(iid, obj, IMidiMapping::iid, IMidiMapping)
+	return EditControllerEx1::queryInterface(iid, obj);
 }
 
+
 tresult PLUGIN_API SmoothieController::initialize(FUnknown* context)
 {
 	LOG("SmoothieController::initialize called.\n");
@@ -164,25 +216,51 @@ tresult PLUGIN_API SmoothieController::initialize(FUnknown* context)
 		return result;
 	}
 
-	char16_t unit_name[32] = STR16("Smoothed");
-	char16_t in_name[32] = STR16("InParam");
-	char16_t out_name[32] = STR16("OutParam");
-	char16_t s_name[32] = STR16("Slowness");
-	char16_t* unit_index = unit_name + std::char_traits<char16_t>::length(unit_name);
-	char16_t* in_index = in_name + std::char_traits<char16_t>::length(in_name);
-	char16_t* out_index = out_name + std::char_traits<char16_t>::length(out_name);
-	char16_t* s_index = s_name + std::char_traits<char16_t>::length(s_name);
-
-	for (int32 i = 0; i < num_smoothed_params; ++i)
+	// Build all units and parameters in one pass, in pooled storage, with names left for getParameterInfo
+	// and getUnitInfo to fill in on demand.
+	constexpr int32 slowness_params_per_triad = 2;  // Slowness and FallSlowness
+	releasePools();
+	parameters.init(num_params);
+	unit_pool.reserve(num_smoothed_params);
+	param_pool.reserve(num_smoothed_params * (NumParamOffsets + NumExtraParamOffsets - slowness_params_per_triad));
+	slowness_pool.reserve(num_smoothed_params * slowness_params_per_triad);
+	bool pools_filled = true;
+	for (int32 i = 0; i < num_smoothed_params && pools_filled; ++i)
 	{
-		uint32_to_str16(unit_index, i + 1);
-		uint32_to_str16(in_index, i + 1);
-		uint32_to_str16(out_index, i + 1);
-		uint32_to_str16(s_index, i + 1);
-		addUnit(new Unit(unit_name, i + 1));
-		parameters.addParameter(in_name, nullptr, 0, 0., ParameterInfo::kCanAutomate, i * NumParamOffsets + InParamOffset, i + 1);
-		parameters.addParameter(out_name, nullptr, 0, 0., ParameterInfo::kCanAutomate, i * NumParamOffsets + OutParamOffset, i + 1);
-		parameters.addParameter(new SmoothnessParam(s_name, i * NumParamOffsets + SlownessOffset, i + 1));
+		Unit* unit = add_to_pool(unit_pool, STR16(""), i + 1);
+		Parameter* in = add_to_pool(param_pool, STR16(""), i * NumParamOffsets + InParamOffset, nullptr, 0., 0, ParameterInfo::kCanAutomate, i + 1);
+		Parameter* out = add_to_pool(param_pool, STR16(""), i * NumParamOffsets + OutParamOffset, nullptr, 0., 0, ParameterInfo::kCanAutomate, i + 1);
+		SmoothnessParam* slowness = add_to_pool(slowness_pool, STR16(""), i * NumParamOffsets + SlownessOffset, i + 1);
+		pools_filled = unit && in && out && slowness;
+		if (pools_filled)
+		{
+			addUnit(unit);
+			parameters.addParameter(in);
+			parameters.addParameter(out);
+			parameters.addParameter(slowness);
+		}
+	}
+	for (int32 i = 0; i < num_smoothed_params && pools_filled; ++i)
+	{
+		const ParamID extra = extra_params_base + i * NumExtraParamOffsets;
+		SmoothnessParam* fall = add_to_pool(slowness_pool, STR16(""), extra + FallSlownessOffset, i + 1);
+		Parameter* separate = add_to_pool(param_pool, STR16(""), extra + SeparateFallOffset, nullptr, 0., 1, ParameterInfo::kCanAutomate, i + 1);
+		Parameter* sync = add_to_pool(param_pool, STR16(""), extra + TempoSyncOffset, nullptr, 0., 1, ParameterInfo::kCanAutomate, i + 1);
+		pools_filled = fall && separate && sync;
+		if (pools_filled)
+		{
+			parameters.addParameter(fall);
+			parameters.addParameter(separate);
+			parameters.addParameter(sync);
+			slowness_pool[i].setTempoSync(sync);
+			fall->setTempoSync(sync);
+		}
+	}
+	if (!pools_filled)
+	{
+		releasePools();  // should never happen (pools reserved above for every parameter)
+		LOG("SmoothieController::initialize exited prematurely because its parameter pools are too small.\n");
+		return kResultFalse;
 	}
 
 	LOG("SmoothieController::initialize exited normally with code %d.\n", result);
@@ -193,10 +271,44 @@ tresult PLUGIN_API SmoothieController::terminate()
 {
 	LOG("SmoothieController::terminate called.\n");
 	tresult result = EditControllerEx1::terminate();
+	releasePools();
 	LOG("SmoothieController::terminate exited with code %d.\n", result);
 	return result;
 }
 
+tresult PLUGIN_API SmoothieController::getParameterInfo(int32 paramIndex, ParameterInfo& info)
+{
+	LOG("SmoothieController::getParameterInfo called.\n");
+	tresult result = EditControllerEx1::getParameterInfo(paramIndex, info);
+	if (result == kResultOk && info.title[0] == 0 && info.id < num_params)
+	{
+		static const TChar* const names[NumParamOffsets] = { STR16("InParam"), STR16("OutParam"), STR16("Slowness") };
+		static const TChar* const extra_names[NumExtraParamOffsets] = { STR16("FallSlowness"), STR16("SeparateFall"), STR16("TempoSync") };
+		const ParamID extra = info.id - extra_params_base;
+		const TChar* name = (info.id < extra_params_base) ? names[info.id % NumParamOffsets] : extra_names[extra % NumExtraParamOffsets];
+		TChar* p = info.title;
+		while (*name) *p++ = *name++;
+		uint32_to_str16(p, ((info.id < extra_params_base) ? info.id / NumParamOffsets : extra / NumExtraParamOffsets) + 1);
+	}
+	LOG("SmoothieController::getParameterInfo exited with code %d.\n", result);
+	return result;
+}
+
+tresult PLUGIN_API SmoothieController::getUnitInfo(int32 unitIndex, UnitInfo& info)
+{
+	LOG("SmoothieController::getUnitInfo called.\n");
+	tresult result = EditControllerEx1::getUnitInfo(unitIndex, info);
+	if (result == kResultOk && info.name[0] == 0 && info.id > 0)
+	{
+		const TChar* name = STR16("Smoothed");
+		TChar* p = info.name;
+		while (*name) *p++ = *name++;
+		uint32_to_str16(p, info.id);
+	}
+	LOG("SmoothieController::getUnitInfo exited with code %d.\n", result);
+	return result;
+}
+
 tresult PLUGIN_API SmoothieController::setComponentState(IBStream* state)
 {
 	LOG("SmoothieController::setComponentState called.\n");
@@ -206,24 +318,44 @@ tresult PLUGIN_API SmoothieController::setComponentState(IBStream* state)
 		return kResultFalse;
 	}
 
-	IBStreamer streamer(state, kLittleEndian);
-	for (uint32 i = 0; i < num_smoothed_params; ++i)
+	ParamSet values[num_smoothed_params];
+	const int32 triads = read_state(state, values, num_smoothed_params);
+	if (triads < 0)
 	{
-		ParamValue vals[NumParamOffsets];
-		if (!streamer.readDoubleArray(vals, NumParamOffsets))
-		{
-			LOG("SmoothieController::setComponentState stopped early with %dx3 records read.\n", i);
-			return kResultOk;
-		}
-		setParamNormalized(i * NumParamOffsets + InParamOffset, vals[0]);
-		setParamNormalized(i * NumParamOffsets + OutParamOffset, vals[1]);
-		setParamNormalized(i * NumParamOffsets + SlownessOffset, vals[2]);
+		LOG("SmoothieController::setComponentState failed due to invalid state header.\n");
+		return kResultFalse;
+	}
+	for (int32 i = 0; i < triads; ++i)
+	{
+		setParamNormalized(i * NumParamOffsets + InParamOffset, values[i].in);
+		setParamNormalized(i * NumParamOffsets + OutParamOffset, values[i].out);
+		setParamNormalized(i * NumParamOffsets + SlownessOffset, values[i].slowness);
+		const ParamID extra = extra_params_base + i * NumExtraParamOffsets;
+		setParamNormalized(extra + FallSlownessOffset, values[i].fall_slowness);
+		setParamNormalized(extra + SeparateFallOffset, values[i].separate_fall ? 1. : 0.);
+		setParamNormalized(extra + TempoSyncOffset, values[i].tempo_sync ? 1. : 0.);
 	}
+	if (triads < num_smoothed_params)
+		LOG("SmoothieController::setComponentState stopped early with %d triads read.\n", triads);
 
 	LOG("SmoothieController::setComponentState exited normally.\n");
 	return kResultOk;
 }
 
+// A TempoSync change changes how its triad's Slowness and FallSlowness values display, so have the host
+// redraw them.
+tresult PLUGIN_API SmoothieController::setParamNormalized(ParamID tag, ParamValue value)
+{
+	LOG("SmoothieController::setParamNormalized called.\n");
+	const bool is_sync = (tag >= extra_params_base && tag < num_params && (tag - extra_params_base) % NumExtraParamOffsets == TempoSyncOffset);
+	const bool was_on = is_sync && getParamNormalized(tag) >= .5;
+	tresult result = EditControllerEx1::setParamNormalized(tag, value);
+	if (is_sync && result == kResultOk && (value >= .5) != was_on && componentHandler)
+		componentHandler->restartComponent(kParamValuesChanged);
+	LOG("SmoothieController::setParamNormalized exited with code %d.\n", result);
+	return result;
+}
+
 tresult PLUGIN_API SmoothieController::getMidiControllerAssignment(int32 busIndex, int16 midiChannel, CtrlNumber midiControllerNumber, ParamID& tag)
 {
 	LOG("SmoothieController::getMidiControllerAssignment called.\n");
@@ -235,4 +367,38 @@ tresult PLUGIN_API SmoothieController::getMidiControllerAssignment(int32 busInde
 	}
 	LOG("SmoothieController:getMidiControllerAssignment exited with failure.\n");
 	return kResultFalse;
+}
+
+void SmoothieController::requestPerfCounters(void)
+{
+	LOG("SmoothieController::requestPerfCounters called.\n");
+	IPtr<IMessage> message = owned(allocateMessage());
+	if (message)
+	{
+		message->setMessageID(perf_request_msg);
+		sendMessage(message);
+	}
+	LOG("SmoothieController::requestPerfCounters exited.\n");
+}
+
+void SmoothieController::getPerfCounters(uint64 (&out)[NumPerfCounters]) const
+{
+	memcpy(out, perf_snapshot, sizeof(perf_snapshot));
+}
+
+tresult PLUGIN_API SmoothieController::notify(IMessage* message)
+{
+	LOG("SmoothieController::notify called.\n");
+	if (message && !strcmp(message->getMessageID(), perf_reply_msg))
+	{
+		const void* data;
+		uint32 size;
+		if (message->getAttributes()->getBinary(perf_reply_attr, data, size) == kResultOk && size == sizeof(perf_snapshot))
+			memcpy(perf_snapshot, data, size);
+		LOG("SmoothieController::notify exited after receiving performance counters.\n");
+		return kResultOk;
+	}
+	tresult result = EditControllerEx1::notify(message);
+	LOG("SmoothieController::notify exited with code %d.\n", result);
+	return result;
 }
\ No newline at end of file
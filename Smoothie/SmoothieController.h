@@ -1,6 +1,9 @@
 #pragma once
 
 #include "public.sdk/source/vst/vsteditcontroller.h"
+#include "pluginterfaces/vst/ivstmessage.h"
+#include "Smoothie.h"
+#include <vector>
 
 using namespace Steinberg;
 using namespace Steinberg::Vst;
@@ -8,6 +11,20 @@ using namespace Steinberg::Vst;
 // Plugin controller GUID - must be unique
 static const FUID SmoothieControllerUID(0xbe1df3c4, 0x903a464c, 0xbc64cea7, 0xa2059f50);
 
+// An FObject that lives in storage owned by the controller rather than on its own heap allocation, so it
+// is not deleted when its reference count drops to zero.  The owner must outlive all references to it.
+template <class T>
+class Pooled : public T
+{
+public:
+	using T::T;
+
+	uint32 PLUGIN_API release() SMTG_OVERRIDE
+	{
+		return (uint32)FUnknownPrivate::atomicAdd(this->refCount, -1);
+	}
+};
+
 class SmoothnessParam : public RangeParameter
 {
 public:
@@ -17,12 +34,18 @@ public:
 	void setMin(ParamValue value) {};
 	void setMax(ParamValue value) {};
 
+	// Display values in beats rather than seconds while this toggle parameter is on
+	void setTempoSync(const Parameter* sync) { tempo_sync = sync; }
+
 	ParamValue toPlain(ParamValue normValue) const SMTG_OVERRIDE;
 	ParamValue toNormalized(ParamValue plainValue) const SMTG_OVERRIDE;
 	void toString(ParamValue normValue, String128 string) const SMTG_OVERRIDE;
 	bool fromString(const TChar* string, ParamValue& normValue) const SMTG_OVERRIDE;
 
 	~SmoothnessParam(void);
+
+private:
+	const Parameter* tempo_sync = nullptr;
 };
 
 class SmoothieController : public EditControllerEx1, public IMidiMapping
@@ -41,8 +64,27 @@ public:
 	tresult PLUGIN_API initialize(FUnknown* context) SMTG_OVERRIDE;
 	tresult PLUGIN_API terminate() SMTG_OVERRIDE;
 	tresult PLUGIN_API setComponentState(IBStream* state) SMTG_OVERRIDE;
+	tresult PLUGIN_API setParamNormalized(ParamID tag, ParamValue value) SMTG_OVERRIDE;
 	tresult PLUGIN_API getMidiControllerAssignment(int32 busIndex, int16 channel, CtrlNumber midiControllerNumber, ParamID& id) SMTG_OVERRIDE;
+	tresult PLUGIN_API notify(IMessage* message) SMTG_OVERRIDE;
+	tresult PLUGIN_API getParameterInfo(int32 paramIndex, ParameterInfo& info) SMTG_OVERRIDE;
+	tresult PLUGIN_API getUnitInfo(int32 unitIndex, UnitInfo& info) SMTG_OVERRIDE;
+
+	// Ask the processor for a fresh copy of its performance counters (delivered asynchronously via notify).
+	void requestPerfCounters(void);
+	// Get the most recent copy of the processor's performance counters received by this controller.
+	void getPerfCounters(uint64 (&out)[NumPerfCounters]) const;
 
 	~SmoothieController(void);
+
+protected:
+	uint64 perf_snapshot[NumPerfCounters] = {};
+
+	// Storage for all units and parameters, allocated in one pass by initialize.  Their names are
+	// generated on demand by getParameterInfo and getUnitInfo.
+	std::vector<Pooled<Unit>> unit_pool;
+	std::vector<Pooled<Parameter>> param_pool;
+	std::vector<Pooled<SmoothnessParam>> slowness_pool;
+	void releasePools(void);
 };
 
@@ -0,0 +1,691 @@
+#include "SmoothieEngine.h"
+
+#include <cmath>
+
+constexpr double small_double = 0.00001;
+constexpr double tiny_double = 1e-12;  // differences below this are floating-point noise
+static inline bool roughly_equal(double x, double y)
+{
+	double diff = x - y;
+	return (-small_double <= diff) && (diff <= small_double);
+}
+
+// (A NaN fails every comparison, so these test for being in range rather than out of it, constraining NaN to 0.)
+#define CONSTRAIN(var) if (!((var) >= 0.)) (var) = 0.; else if ((var) > 1.) (var) = 1.
+#define CONSTRAIN_CC(var) if (!((var) >= 0.)) (var) = 0.; else if ((var) > 127.) (var) = 127.
+
+// Constrain a smoother's stored values to [0,1], e.g. after a caller or a corrupt saved state set them
+static inline void constrain_state(ParamSet& state)
+{
+	CONSTRAIN(state.in);
+	CONSTRAIN(state.out);
+	CONSTRAIN(state.slowness);
+	CONSTRAIN(state.fall_slowness);
+}
+
+// Maximum speed of OutParam (in units per sample) for the given Slowness, where rate is the number of samples
+// per second (or per beat, for a tempo-synced smoother; see slowness_rate)
+static inline double max_slope_of(double slowness, double rate)
+{
+	return (slowness <= 0.) ? 1. : ((1. - slowness) / slowness / secs_per_half_slowness / rate);
+}
+
+static inline double slowness_rate(const ParamSet& state, double sample_rate, double tempo)
+{
+	return state.tempo_sync ? sample_rate * 60. / ((tempo > 0.) ? tempo : default_tempo) : sample_rate;
+}
+
+// The Slowness that limits OutParam's movement toward InParam
+static inline double chase_slowness(const ParamSet& state)
+{
+	return (state.separate_fall && state.in < state.out) ? state.fall_slowness : state.slowness;
+}
+
+// Distance from OutParam to (the constrained) InParam
+static inline double distance_to_target(const ParamSet& state)
+{
+	double target = state.in;
+	CONSTRAIN(target);
+	return (target >= state.out) ? (target - state.out) : (state.out - target);
+}
+
+// True if OutParam will stay where it is until new points arrive:  it has reached InParam, or Slowness
+// is so high that it never moves.  (Within small_double of InParam, OutParam moves onto it regardless of
+// Slowness, so it has reached InParam only once the remaining difference is floating-point noise.)
+static inline bool is_parked(const ParamSet& state)
+{
+	const double distance = distance_to_target(state);
+	return distance <= tiny_double || (distance > small_double && chase_slowness(state) >= 1.);
+}
+
+static inline void get_point(const CurveSpan& curve, int32_t index, int32_t& offset, double& value)
+{
+	offset = curve.points[index].offset;
+	value = curve.points[index].value;
+}
+
+// Fixed-point scale for CC computations:  127 * value is represented as an integer multiple of 1/cc_one.
+// (Small enough that 127 * cc_one times any block length fits comfortably in 64 bits.)
+constexpr int64_t cc_one = (int64_t)1 << 20;
+
+static inline int64_t to_cc_fixed(double value)
+{
+	double cc = 127. * value;
+	CONSTRAIN_CC(cc);  // also keeps NaN out of llround, whose result would then be unspecified
+	return std::llround(cc * (double)cc_one);
+}
+
+// Round a fixed-point CC value to the nearest CC value (halves round up)
+static inline int32_t cc_of(int64_t fixed)
+{
+	return (int32_t)((fixed + cc_one / 2) / cc_one);
+}
+
+static void add_cc(SmootherOutput& output, int32_t offset, int32_t value)
+{
+	if (!output.cc)
+		return;
+	if (output.cc_count > 0 && output.cc[output.cc_count - 1].offset == offset)
+	{
+		// Coalesce several changes at one sample offset into the last of them.
+		output.cc[output.cc_count - 1].value = (uint8_t)value;
+		return;
+	}
+	if (output.cc_count < output.cc_capacity)
+		++output.cc_count;
+	else
+	{
+		// Out of storage:  replace the last change (if any), so that at least the final value is right.
+		++output.cc_dropped;
+		if (output.cc_count <= 0)
+			return;
+	}
+	output.cc[output.cc_count - 1] = { offset, (uint8_t)value };
+}
+
+// Emit the CC changes along the OutParam segment from (firstSampleOffset, state.out) to (finalSampleOffset,
+// finalval).  At each sample of the segment, the CC value is 127 * OutParam rounded to the nearest integer,
+// and a change is emitted at exactly the samples where that rounded value differs from the last one emitted.
+// The samples at which the segment crosses each CC threshold (an odd multiple of 1/254) are found by
+// stepping an integer quotient and remainder (Bresenham's method), so the cost is proportional to the number
+// of CC values crossed, not to the length of the segment.  The last CC value is kept in the state, so a
+// curve that continues across segments and blocks is quantized as a whole.
+static void add_cc_segment(ParamSet& state, SmootherOutput& output, int32_t firstSampleOffset, int32_t finalSampleOffset, double finalval)
+{
+	const int64_t a = to_cc_fixed(state.out);
+	const int64_t b = to_cc_fixed(finalval);
+	const int32_t startCC = cc_of(a);
+	const int32_t finalCC = cc_of(b);
+	if (!output.cc || (finalCC == startCC && finalCC == state.last_cc))
+	{
+		state.last_cc = finalCC;
+		return;
+	}
+	if (finalSampleOffset <= firstSampleOffset || finalCC == startCC)
+	{
+		add_cc(output, (finalSampleOffset <= firstSampleOffset) ? finalSampleOffset : firstSampleOffset + 1, state.last_cc = finalCC);
+		return;
+	}
+
+	// At sample firstSampleOffset + i, 0 <= i <= n, the fixed-point CC value is a + d * i / n.  It rounds to
+	// at least k iff n * (a + cc_one / 2) + d * i >= n * k * cc_one.  Resume from the last CC value output
+	// (crossings of thresholds before the segment starts land on its first sample) unless that value lies
+	// beyond the segment's end, in which case restart from the value at its start.
+	const int64_t n = finalSampleOffset - firstSampleOffset;
+	const int64_t d = b - a;
+	const int32_t dir = (d > 0) ? 1 : -1;
+	int32_t k = state.last_cc;
+	if ((k - finalCC) * dir >= 0)
+		add_cc(output, firstSampleOffset + 1, k = startCC);
+	k += dir;
+
+	// For each threshold crossed, the first sample offset at or beyond it is i = ceil(num / den), where num
+	// steps by n * cc_one per threshold.
+	const int64_t den = (d > 0) ? d : -d;
+	const int64_t num = (d > 0) ? (n * (k * cc_one - cc_one / 2 - a)) : (n * (a + cc_one / 2 - (k + 1) * cc_one) + 1);
+	int64_t q = num / den;
+	int64_t r = num % den;
+	if (r < 0)
+	{
+		r += den;
+		--q;
+	}
+	int64_t step_q = -1, step_r = 0;
+	for (;;)
+	{
+		const int64_t i = q + (r > 0 ? 1 : 0);
+		add_cc(output, firstSampleOffset + (int32_t)((i < 1) ? 1 : i), state.last_cc = k);
+		if (k == finalCC)
+			break;
+		if (step_q < 0)
+		{
+			step_q = n * cc_one / den;
+			step_r = n * cc_one % den;
+		}
+		k += dir;
+		q += step_q;
+		r += step_r;
+		if (r >= den)
+		{
+			r -= den;
+			++q;
+		}
+	}
+}
+
+static void add_out_point(ParamSet& state, SmootherOutput& output, int32_t firstSampleOffset, int32_t finalSampleOffset, double finalval)
+{
+	if (output.points)
+	{
+		if (output.point_count < output.point_capacity)
+			++output.point_count;
+		if (output.point_count > 0)
+			output.points[output.point_count - 1] = { finalSampleOffset, finalval };
+	}
+	add_cc_segment(state, output, firstSampleOffset, finalSampleOffset, finalval);
+	state.out = finalval;
+}
+
+static double interpolate(int32_t x0, double y0, int32_t x1, double y1, int32_t x)
+{
+	if (x1 == x0)
+	{
+		if (y1 == y0)
+			return y0;
+		else if (x == x0)
+			return y1;
+		else if (y1 > y0)
+			return (x > x1) ? 1. : 0.;
+		else
+			return (x > x1) ? 0. : 1.;
+	}
+	else
+	{
+		double y = (double)(x - x0) / (double)(x1 - x0) * (y1 - y0) + y0;
+		CONSTRAIN(y);
+		return y;
+	}
+}
+
+// Smooth one smoother's OutParam over the current block.  The template arguments say which of the incoming
+// automation curves have points in this block; the code for reading the others is compiled out, yielding a
+// specialized kernel for each common block shape.  <true, true, true> is the general case.
+template <bool HasIn, bool HasOut, bool HasSlowness>
+static void smooth_kernel(ParamSet& state, const SmootherInput& input, int32_t num_samples, double sample_rate, SmootherOutput& output, double tempo)
+{
+	// (in_x0,in_y0)--(in_x1,in_y1) is the last processed segment in InParam's automation curve,
+	// and in_index is the index of the next point in its curve.
+	int32_t in_x0 = -1;
+	double in_y0 = state.in;
+	int32_t in_x1 = -1;
+	double in_y1 = in_y0;
+	int32_t in_index = 0;
+
+	// (slowness_x,slowness) is the last processed point in Slowness's automation curve,
+	// and slowness_index is the index of the next point in its curve.  Likewise for FallSlowness, whose
+	// curve is read only if it limits falls separately.
+	int32_t slowness_x = -1;
+	double slowness = state.slowness;
+	int32_t slowness_index = 0;
+	int32_t fall_x = -1;
+	double fall_slowness = state.fall_slowness;
+	int32_t fall_index = 0;
+	const bool separate_fall = state.separate_fall;
+
+	// OutParam's maximum speeds up and down, recomputed only when a Slowness point changes them
+	const double rate = slowness_rate(state, sample_rate, tempo);
+	double rise_slope = max_slope_of(slowness, rate);
+	double fall_slope = separate_fall ? max_slope_of(fall_slowness, rate) : rise_slope;
+
+	// Start quantizing from OutParam's current CC value if no CC value has been output yet
+	if (state.last_cc < 0)
+		state.last_cc = cc_of(to_cc_fixed(state.out));
+
+	// (out_x0,out_y0) = the last OutParam automation curve point that was output.
+	// (The point at offset -1 was implicitly output by the last call to process().)
+	// Invariant: in_x0 <= out_x0
+	int32_t out_x0 = -1;
+	double out_y0 = state.out;
+	const int32_t numOutPoints = HasOut ? input.out.count : 0;
+	for (int32_t out_index = 0; (uint32_t)out_index <= (uint32_t)numOutPoints; ++out_index)
+	{
+		int32_t out_x1 = num_samples - 1;
+		double out_y1 = out_y0;
+		if constexpr (HasOut)
+		{
+			if (out_index < numOutPoints)
+			{
+				get_point(input.out, out_index, out_x1, out_y1);
+				if (out_x1 >= num_samples) out_x1 = num_samples - 1; // should never happen (host served invalid point queue)
+				CONSTRAIN(out_y1);
+			}
+			if (out_x1 <= out_x0)
+			{
+				// should never happen (host served invalid point queue)
+				out_y0 = out_y1;
+				continue;
+			}
+			else if (!roughly_equal(out_y0, out_y1))
+			{
+				// The received curve for OutParam changed it over interval (out_x0, out_x1],
+				// overriding any smoothing, so output that segment as-received.
+				++output.overrides;
+				add_out_point(state, output, out_x0, out_x1, out_y1);
+				out_x0 = out_x1;
+				out_y0 = out_y1;
+				continue;
+			}
+		}
+		// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
+
+		// The received curve for OutParam didn't change (much) over interval (out_x0, out_x1].
+		// Merge all consecutive segments that don't change it (much) until we reach a segment
+		// that does change it, or we reach the end of the sample buffer.
+		if constexpr (HasOut)
+		{
+			while (out_index < numOutPoints)
+			{
+				int32_t out_x2 = num_samples - 1;
+				double out_y2 = out_y1;
+				if (out_index + 1 < numOutPoints)
+					get_point(input.out, out_index + 1, out_x2, out_y2);
+				CONSTRAIN(out_y2);
+				if (!roughly_equal(out_y1, out_y2))
+					break;
+				++out_index;
+				if (out_x2 >= num_samples) out_x2 = num_samples - 1; // should never happen (host served invalid point queue)
+				if (out_x1 < out_x2) out_x1 = out_x2; // should always happen (otherwise host served invalid point queue)
+				out_y1 = out_y2;
+			}
+		}
+		// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
+
+		// OutParam is unchanging over interval (out_x0, out_x1], and out_x1 is either the
+		// start of a host-overridden segment or the end of the sample buffer (numSamples - 1).
+		// Proceed to smoothly migrate OutParam toward InParam over interval (out_x0, out_x1]...
+
+		while (out_x0 < out_x1)
+		{
+			// Find the first segment of InParam's automation curve that ends strictly after out_x0
+			// Invariant: in_x0 <= out_x0 < out_x1 < numSamples
+			while (in_x1 <= out_x0)
+			{
+				in_x0 = in_x1;
+				in_y0 = in_y1;
+				if (HasIn && in_index < input.in.count)
+				{
+					get_point(input.in, in_index, in_x1, in_y1);
+					if (in_x1 < in_x0) in_x1 = in_x0; // should never happen (host served invalid point queue)
+					else if (in_x1 >= num_samples) in_x1 = num_samples - 1; // should never happen (host served invalid point queue)
+					++in_index;
+					CONSTRAIN(in_y1);
+				}
+				else
+				{
+					in_x1 = num_samples - 1;
+					break;
+				}
+			}
+			// Postcondition: in_x0 <= out_x0 < in_x1 < numSamples
+			// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
+
+			// Find the first point of Slowness's automation curve that is strictly after out_x0
+			while (slowness_x <= out_x0)
+			{
+				if (HasSlowness && slowness_index < input.slowness.count)
+				{
+					get_point(input.slowness, slowness_index, slowness_x, slowness);
+					++slowness_index;
+					if (slowness_x >= num_samples) slowness_x = num_samples - 1; // should never happen (host served invalid point queue)
+					CONSTRAIN(slowness);
+					rise_slope = max_slope_of(slowness, rate);
+					if (!separate_fall)
+						fall_slope = rise_slope;
+				}
+				else
+				{
+					slowness_x = num_samples - 1;
+					break;
+				}
+			}
+			// Postcondition: out_x0 < slowness_x < numSamples
+
+			// Likewise for FallSlowness
+			while (fall_x <= out_x0)
+			{
+				if (HasSlowness && separate_fall && fall_index < input.fall_slowness.count)
+				{
+					get_point(input.fall_slowness, fall_index, fall_x, fall_slowness);
+					++fall_index;
+					if (fall_x >= num_samples) fall_x = num_samples - 1; // should never happen (host served invalid point queue)
+					CONSTRAIN(fall_slowness);
+					fall_slope = max_slope_of(fall_slowness, rate);
+				}
+				else
+				{
+					fall_x = num_samples - 1;
+					break;
+				}
+			}
+			// Postcondition: out_x0 < fall_x < numSamples
+			// Postcondition: in_x0 <= out_x0 < in_x1 < numSamples
+			// Postcondition: in_x0 <= out_x0 < out_x1 < numSamples
+
+			// Let x be the first sample offset within (out_x0,out_x1] where InParam, Slowness, or FallSlowness
+			// changes (or let x = out_x1 if none changes anywhere within that interval).
+			int32_t x = (in_x1 <= slowness_x) ? in_x1 : slowness_x;
+			if (x > fall_x) x = fall_x;
+			if (x > out_x1) x = out_x1;
+			// Postcondition: out_x0 < x <= out_x1 < numSamples
+
+			// Prepare to output a new OutParam automation curve point at x...
+			// Note:  in_x1 - in_x0 > 0 because in_x0 <= out_x0 < in_x1
+			const double in_slope = (in_y1 - in_y0) / (double)(in_x1 - in_x0);
+			in_y0 = interpolate(in_x0, in_y0, in_x1, in_y1, out_x0);
+			in_x0 = out_x0;
+			double param_diff = in_y0 - out_y0;
+			if (param_diff < 0.)
+				param_diff = -param_diff;
+			double out_slope, y = out_y0;
+
+			// If OutParam can catch the InParam's automation curve (without exceeding its max speed) before x,
+			// output an extra automation curve point for OutParam at the intersection point of the two curves.
+			// Otherwise move it toward InParam at its max allowed speed.  An intersection that rounds to out_x0
+			// or x is caught there, rather than overshot by moving at max speed for the whole segment.
+			if (param_diff > small_double)
+			{
+				out_slope = (in_y0 > out_y0) ? rise_slope : -fall_slope;
+				const double catch_time = (in_slope == out_slope) ? -1. : ((in_y0 - out_y0) / (out_slope - in_slope));
+				if (0. <= catch_time && catch_time < (double)(x - out_x0))
+				{
+					const int32_t intersection_x = out_x0 + (int32_t)std::round(catch_time);
+					if (intersection_x <= out_x0)
+					{
+						out_y0 = in_y0;
+						param_diff = 0.;
+					}
+					else if (intersection_x < x)
+					{
+						double intersection_y = in_y0 + in_slope * (double)(intersection_x - out_x0);
+						CONSTRAIN(intersection_y);
+						add_out_point(state, output, out_x0, intersection_x, intersection_y);
+						out_x0 = in_x0 = intersection_x;
+						out_y0 = in_y0 = intersection_y;
+						param_diff = 0.;
+					}
+					else
+					{
+						y = in_y0 + in_slope * (double)(x - out_x0);
+					}
+				}
+				else
+				{
+					y = out_y0 + out_slope * (double)(x - out_x0);
+				}
+			}
+
+			// If OutParam has already reached InParam, make it follow InParam's movement up to its max allowed speed.
+			// (When InParam outruns it, OutParam continues from where it is rather than from InParam, so that a
+			// lag of up to small_double isn't forgiven anew at every breakpoint of a dense InParam curve.)
+			if (param_diff <= small_double)
+			{
+				if (in_slope < -fall_slope)
+				{
+					out_slope = -fall_slope;
+					y = out_y0 + out_slope * (double)(x - out_x0);
+				}
+				else if (in_slope <= rise_slope)
+				{
+					out_slope = in_slope;
+					y = interpolate(in_x0, in_y0, in_x1, in_y1, x);
+				}
+				else
+				{
+					out_slope = rise_slope;
+					y = out_y0 + out_slope * (double)(x - out_x0);
+				}
+			}
+
+			CONSTRAIN(y);
+
+			// Output the computed automation curve point for OutParam (but omit it if it's at the
+			// end of a flat segment of the curve at the end of the buffer, as per the VST3 standard).
+			// Only a truly flat segment is omitted (not merely one that moves less than small_double),
+			// since each omitted movement would be lost, and dense InParam curves make them arbitrarily small.
+			// (Compare with the last point output rather than out_y0, which a catch at out_x0 may have moved.)
+			if (!(x >= num_samples - 1 && std::fabs(y - state.out) <= tiny_double))
+				add_out_point(state, output, out_x0, x, y);
+
+			// Shift out_x0 forward to the most recently outputted point, and continue until the
+			// end of the non-overridden OutParam segment is reached.
+			out_x0 = x;
+			out_y0 = y;
+		}
+		// Postcondition: out_x0 == out_x1
+
+		// Point (out_x1, ?) is the boundary between the end of a VST-generated smoothed curve and a
+		// host-generated segment that overrides the VST's curve.  For best smoothing, we interpret
+		// this point as having y-value equal to the VST-generated smoothed curve's value, so that the
+		// overridden segment starts as a 0% override and linearly progresses to a 100% override by
+		// the end of the overridden segment.  When the override is a jump in the curve (common case),
+		// this preserves the jump; but when the override is a gradual change (e.g., introduced by
+		// host automation), this replaces the overridden segment with a smooth transition from the
+		// VST-generated smoothed segment's end to the host-generated overridden segment's end.
+		out_y1 = out_y0;
+
+		// Now continue with the next segment (if any) of the incoming OutParam automation curve
+		// (which will always be an overridden segment if we got this far in the loop body)...
+	}
+}
+
+// Smooth one smoother's OutParam over a block with no incoming points while OutParam is still moving toward
+// InParam.  InParam and Slowness are constant over the block, so OutParam moves toward InParam at constant
+// speed and either arrives at a computable sample or is still moving at the end of the block.  Either way
+// its curve is a single segment, computed here in closed form.  The result is exactly that of
+// smooth_kernel<false, false, false>, which takes a pass through its segment loop to reach the same point.
+static void smooth_ramp(ParamSet& state, int32_t num_samples, double sample_rate, SmootherOutput& output, double tempo)
+{
+	if (state.last_cc < 0)
+		state.last_cc = cc_of(to_cc_fixed(state.out));
+
+	double target = state.in;
+	CONSTRAIN(target);
+	const double distance = target - state.out;
+	const double slowness = (distance < 0. && state.separate_fall) ? state.fall_slowness : state.slowness;
+	const double max_slope = max_slope_of(slowness, slowness_rate(state, sample_rate, tempo));
+	const int32_t last = num_samples - 1;
+	int32_t arrival = last;
+	double y = target;
+	if (distance > small_double || distance < -small_double)
+	{
+		// Arrive at the sample nearest the intersection with InParam, or move at max speed for the whole
+		// block if it doesn't reach InParam by the end.  (An intersection that rounds to the sample before the
+		// block means OutParam is already there, so it steps the rest of the way by the end of the block.)
+		const double out_slope = (distance > 0.) ? max_slope : -max_slope;
+		const double catch_time = (out_slope == 0.) ? -1. : (distance / out_slope);
+		if (0. <= catch_time && catch_time < (double)num_samples)
+		{
+			const int32_t intersection_x = -1 + (int32_t)std::round(catch_time);
+			if (intersection_x >= 0)
+				arrival = intersection_x;
+		}
+		else
+		{
+			y = state.out + out_slope * (double)num_samples;
+			CONSTRAIN(y);
+		}
+	}
+
+	// As in smooth_kernel, a point that doesn't move OutParam at the end of the block is omitted.
+	if (!(arrival >= last && std::fabs(y - state.out) <= tiny_double))
+		add_out_point(state, output, -1, arrival, y);
+}
+
+int32_t decimation_stride(int32_t count, int32_t budget)
+{
+	if (budget < 2)
+		budget = 2;
+	if (count <= budget)
+		return 1;
+	return (count - 2) / (budget - 1) + 1;
+}
+
+int32_t decimate_curve(CurvePoint* points, int32_t count, int32_t budget)
+{
+	// (Points are only ever copied down, from index i to kept <= i.)
+	return read_decimated(count, budget, points, [points](int32_t i, CurvePoint& p) { p = points[i]; return true; });
+}
+
+int32_t simplify_ramps(CurvePoint* points, int32_t count, double tolerance)
+{
+	if (count <= 2)
+		return count;
+
+	// points[kept - 1] is the anchor (the last point kept), and points[candidate] is the furthest point that
+	// the anchor can be joined to directly.  Any line from the anchor with a slope in [lo, hi] passes within
+	// tolerance of every point between the anchor and the candidate, including the candidate itself.
+	int32_t kept = 1;
+	int32_t candidate = -1;
+	double lo = 0., hi = 0.;
+	for (int32_t i = 1; i < count; ++i)
+	{
+		if (candidate >= 0)
+		{
+			const int32_t dx = points[i].offset - points[kept - 1].offset;
+			if (dx > 0)
+			{
+				const double dy = points[i].value - points[kept - 1].value;
+				const double slope = dy / (double)dx;
+				if (lo <= slope && slope <= hi)
+				{
+					const double point_lo = (dy - tolerance) / (double)dx;
+					const double point_hi = (dy + tolerance) / (double)dx;
+					if (point_lo > lo) lo = point_lo;
+					if (point_hi < hi) hi = point_hi;
+					candidate = i;
+					continue;
+				}
+			}
+			points[kept++] = points[candidate];
+			candidate = -1;
+		}
+
+		// Start a new run from the anchor.
+		const int32_t dx = points[i].offset - points[kept - 1].offset;
+		if (dx <= 0)
+		{
+			points[kept++] = points[i];  // a jump (or, should never happen, an out-of-order point)
+			continue;
+		}
+		const double dy = points[i].value - points[kept - 1].value;
+		lo = (dy - tolerance) / (double)dx;
+		hi = (dy + tolerance) / (double)dx;
+		candidate = i;
+	}
+	if (candidate >= 0)
+		points[kept++] = points[candidate];
+	return kept;
+}
+
+int32_t simplify_steps(CurvePoint* points, int32_t count)
+{
+	int32_t kept = 0;
+	for (int32_t i = 0; i < count; ++i)
+		if (i + 1 >= count || points[i].value != points[i + 1].value)
+			points[kept++] = points[i];
+	return kept;
+}
+
+int32_t max_output_points(const SmootherInput& input)
+{
+	// Each pass of the smoothing loop emits at most two points (an intersection and a segment end) and ends
+	// at a distinct breakpoint of one of the curves or at the end of the block; each overridden OutParam
+	// segment adds one more point.
+	return 2 * (input.in.count + input.out.count + input.slowness.count + input.fall_slowness.count + 1) + input.out.count;
+}
+
+void smooth_block(ParamSet& state, const SmootherInput& input, int32_t num_samples, double sample_rate, SmootherOutput& output, double tempo)
+{
+	output.point_count = 0;
+	output.cc_count = 0;
+	output.cc_dropped = 0;
+	output.overrides = 0;
+	constrain_state(state);
+
+	if (num_samples > 0 && input.in.count <= 0 && input.out.count <= 0 && input.slowness.count <= 0 && input.fall_slowness.count <= 0
+		&& distance_to_target(state) <= tiny_double)
+	{
+		// Nothing to do:  OutParam has reached InParam and no points arrived, so it stays put and emits nothing
+		// (as the kernels would, omitting a flat final point).
+		if (state.last_cc < 0)
+			state.last_cc = cc_of(to_cc_fixed(state.out));
+	}
+	else if (num_samples > 0)
+	{
+		/* Begin sample-accurate processing of InParam -> OutParam smoothing:
+		 *
+		 * slowness=0 -> changes to InParam are instantly reflected to OutParam
+		 * slowness=.5 -> changes to InParam cause OutParam to move at a rate of secs_per_half_slowness toward InParam
+		 * slowness=1 -> changes to InParam cause OutParam to react infinitely slowly (OutParam never changes)
+		 *
+		 * In general, to make OutParam take n seconds to move from 0 to 1, set slowness to:
+		 *   slowness = n / (n + h)
+		 * where h = secs_per_half_slowness (default=2)
+		 *
+		 * With separate_fall, slowness limits OutParam only while it rises and fall_slowness while it falls.
+		 * With tempo_sync, n and h are in beats rather than seconds.
+		 */
+
+		// Dispatch to the kernel specialized for this block's shape.  Blocks with no incoming points, with
+		// only InParam points (jumps or ramps), or with only Slowness points are the common cases; any block
+		// with OutParam overrides or with several kinds of points takes the general path.  A block with no
+		// incoming points during a fade (the steady state of a long fade) is computed in closed form.
+		const bool hasIn = (input.in.count > 0);
+		const bool hasOut = (input.out.count > 0);
+		const bool hasSlowness = (input.slowness.count > 0 || input.fall_slowness.count > 0);
+		if (!hasOut && !hasSlowness)
+		{
+			if (hasIn)
+				smooth_kernel<true, false, false>(state, input, num_samples, sample_rate, output, tempo);
+			else
+				smooth_ramp(state, num_samples, sample_rate, output, tempo);
+		}
+		else if (!hasOut && !hasIn)
+			smooth_kernel<false, false, true>(state, input, num_samples, sample_rate, output, tempo);
+		else
+			smooth_kernel<true, true, true>(state, input, num_samples, sample_rate, output, tempo);
+	}
+	else if (input.out.count > 0)
+	{
+		// Flush:  adopt OutParam's final value without smoothing.
+		state.out = input.out.points[input.out.count - 1].value;
+	}
+
+	// Update the stored values of InParam and Slowness for use by the next block.
+	if (input.in.count > 0)
+		state.in = input.in.points[input.in.count - 1].value;
+	if (input.slowness.count > 0)
+		state.slowness = input.slowness.points[input.slowness.count - 1].value;
+	if (input.fall_slowness.count > 0)
+		state.fall_slowness = input.fall_slowness.points[input.fall_slowness.count - 1].value;
+	constrain_state(state);
+}
+
+int64_t samples_to_converge(const ParamSet& state, double sample_rate, double tempo)
+{
+	ParamSet constrained = state;
+	constrain_state(constrained);
+	if (is_parked(constrained))
+		return 0;
+	const double distance = distance_to_target(constrained);
+	if (distance <= small_double)
+		return 1;  // moves onto InParam at the end of the next block
+	const double samples = std::ceil(distance / max_slope_of(chase_slowness(constrained), slowness_rate(constrained, sample_rate, tempo)));
+	return (samples < (double)INT64_MAX) ? (int64_t)samples : INT64_MAX;  // (also if sample_rate is not a number)
+}
+
+void smooth_blocks(size_t n, ParamSet* states, const SmootherInput* inputs, int32_t num_samples, double sample_rate, SmootherOutput* outputs, double tempo)
+{
+	for (size_t i = 0; i < n; ++i)
+		smooth_block(states[i], inputs[i], num_samples, sample_rate, outputs[i], tempo);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+// Smoothie's smoothing engine, independent of the VST3 SDK.
+//
+// A smoother chases a target curve (InParam) with an output curve (OutParam) whose speed is limited by a
+// third curve (Slowness), or by separate curves for rising and falling (Slowness and FallSlowness), with
+// sample accuracy.  Slowness is measured in seconds, or in beats of the host's tempo.  The engine advances
+// smoothers one block at a time:  each block's incoming curves are given as arrays of (sample offset, value)
+// breakpoints, and the engine writes the resulting OutParam breakpoints and the 7-bit CC values that
+// approximate them into caller-provided spans.  The VST3 processor (Smoothie.cpp) is a thin adapter over
+// this interface.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+constexpr double secs_per_half_slowness = 2;  // seconds (or beats) to go from 0 to 1 when slowness = .5
+constexpr double default_tempo = 120.;  // beats per minute for tempo-synced smoothers when the host reports none
+
+// Persistent state of one smoother between blocks (parameter values normalized to [0,1]).  The caller sets
+// the two mode flags; a change takes effect from the start of the next block.
+typedef struct param_set {
+	double in = 0;
+	double out = 0;
+	double slowness = .5;
+	double fall_slowness = .5;  // limits falling OutParam instead of slowness if separate_fall is set
+	bool separate_fall = false;
+	bool tempo_sync = false;  // slowness values are in beats rather than seconds
+	int32_t last_cc = -1;  // most recent CC value output for OutParam (-1 if none yet)
+} ParamSet;
+
+// One breakpoint of a piecewise-linear automation curve, at a sample offset within the current block
+typedef struct curve_point {
+	int32_t offset;
+	double value;
+} CurvePoint;
+
+// A read-only run of breakpoints, sorted by offset
+typedef struct curve_span {
+	const CurvePoint* points = nullptr;
+	int32_t count = 0;
+} CurveSpan;
+
+// A change of the 7-bit CC value that approximates OutParam, at a sample offset within the current block
+typedef struct cc_change {
+	int32_t offset;
+	uint8_t value;
+} CCChange;
+
+// Incoming curves of one smoother for one block.  Points in the out curve override the smoothing.
+typedef struct smoother_input {
+	CurveSpan in;
+	CurveSpan out;
+	CurveSpan slowness;
+	CurveSpan fall_slowness;
+} SmootherInput;
+
+// Caller-provided storage for one smoother's output for one block.  The engine sets the counts.  If a span
+// is too small, the engine overwrites its last entry rather than overflowing, so its final value is still
+// correct; size the point span with max_output_points, and the cc span with the block length (at most one
+// CC change per sample), to avoid that.  A null span discards that output.
+typedef struct smoother_output {
+	CurvePoint* points = nullptr;
+	int32_t point_capacity = 0;
+	int32_t point_count = 0;
+	CCChange* cc = nullptr;
+	int32_t cc_capacity = 0;
+	int32_t cc_count = 0;
+	int32_t cc_dropped = 0;  // number of CC changes lost because the cc span was full
+	int32_t overrides = 0;  // number of OutParam segments taken as-received from the out curve
+} SmootherOutput;
+
+// Default limit on the number of points of one incoming curve that one block processes
+constexpr int32_t default_point_budget = 1024;
+
+// Stride with which to read a curve of count points so that at most budget points are used:  points 0,
+// stride, 2 * stride, ..., and always the last point (count - 1).  Returns 1 if the curve is within budget.
+// Decimating this way bounds the work per block no matter how many points a misbehaving host sends, and the
+// result depends only on count and budget.
+int32_t decimation_stride(int32_t count, int32_t budget);
+
+// Read a curve of count points into points[0..budget), decimating it as decimation_stride says:  the point
+// with index i is fetched by calling fetch(i, point), which returns false if the point is unavailable.
+// Unavailable points and points whose value is not a number are skipped.  Returns the number of points read.
+// The plug-in reads host automation queues this way, so this is the one place the point budget is enforced.
+template <typename Fetch>
+int32_t read_decimated(int32_t count, int32_t budget, CurvePoint* points, Fetch fetch)
+{
+	const int32_t stride = decimation_stride(count, budget);
+	int32_t kept = 0;
+	for (int32_t i = 0; i < count;)
+	{
+		if (fetch(i, points[kept]) && !std::isnan(points[kept].value))
+			++kept;
+		// Step by stride, but always finish with the last point.
+		i = (i == count - 1) ? count : (i + stride < count - 1) ? i + stride : count - 1;
+	}
+	return kept;
+}
+
+// Decimate a curve in place to at most budget points (see read_decimated), and return the new point count
+int32_t decimate_curve(CurvePoint* points, int32_t count, int32_t budget);
+
+// Default tolerance for simplify_ramps, well below the engine's own threshold (1e-5) for treating two values
+// as equal
+constexpr double default_ramp_tolerance = 1e-6;
+
+// Simplify a piecewise-linear curve (InParam) in place before smoothing it, and return the new point count.
+// Interior points are dropped wherever the curve through the remaining points stays within tolerance of every
+// dropped point; the first and last points, and both points of any jump, are always kept.  The simplified
+// curve is therefore within tolerance of the original at every sample.  OutParam's speed limit makes it a
+// non-expansive function of InParam (two InParam curves that never differ by more than e produce OutParam
+// curves that never differ by more than e), so smoothing the simplified curve moves OutParam by at most
+// tolerance, apart from where the engine rounds the point at which OutParam catches InParam to a whole
+// sample (as it does for any curve); there the two can differ by up to half a sample times the difference
+// between OutParam's and InParam's slopes.  Runs in linear time.
+int32_t simplify_ramps(CurvePoint* points, int32_t count, double tolerance);
+
+// Simplify a step curve (Slowness or FallSlowness) in place by dropping each point whose value equals the
+// next point's value, and return the new point count.  Each point's value applies up to its offset, so this
+// is exact.
+int32_t simplify_steps(CurvePoint* points, int32_t count);
+
+// Upper bound on the number of OutParam points that one block with the given input can produce
+int32_t max_output_points(const SmootherInput& input);
+
+// Advance one smoother over a block of num_samples samples.  A block of zero samples only adopts the final
+// point of each incoming curve (a parameter flush).  tempo (in beats per minute) matters only if
+// state.tempo_sync is set.
+void smooth_block(ParamSet& state, const SmootherInput& input, int32_t num_samples, double sample_rate, SmootherOutput& output, double tempo = default_tempo);
+
+// Number of samples until OutParam reaches InParam if no new points arrive (0 if it never moves again)
+int64_t samples_to_converge(const ParamSet& state, double sample_rate, double tempo = default_tempo);
+
+// Advance n independent smoothers over the same block.
+void smooth_blocks(size_t n, ParamSet* states, const SmootherInput* inputs, int32_t num_samples, double sample_rate, SmootherOutput* outputs, double tempo = default_tempo);
@@ -6,7 +6,7 @@
 #define PluginCategory "Fx"
 #define PluginName "Smoothie"
 
-#define PLUGINVERSION "1.2.0"
+#define PLUGINVERSION "1.3.0"
 
 bool InitModule()
 {
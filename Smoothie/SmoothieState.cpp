@@ -0,0 +1,130 @@
+#include "base/source/fstreamer.h"
+#include <cstring>
+#include <vector>
+
+#include "SmoothieState.h"
+
+static const char state_magic[8] = { 'S', 'M', 'O', 'O', 'T', 'H', 'I', 'E' };
+constexpr uint32 state_header_size = 24;
+constexpr uint32 legacy_fields_per_triad = 3;
+
+static inline void put_u32(uint8* p, uint32 v)
+{
+	for (int i = 0; i < 4; ++i)
+		p[i] = (uint8)(v >> (8 * i));
+}
+
+static inline uint32 get_u32(const uint8* p)
+{
+	uint32 v = 0;
+	for (int i = 0; i < 4; ++i)
+		v |= (uint32)p[i] << (8 * i);
+	return v;
+}
+
+static inline void put_f64(uint8* p, double value)
+{
+	uint64 v;
+	memcpy(&v, &value, sizeof(v));
+	for (int i = 0; i < 8; ++i)
+		p[i] = (uint8)(v >> (8 * i));
+}
+
+static inline double get_f64(const uint8* p)
+{
+	uint64 v = 0;
+	for (int i = 0; i < 8; ++i)
+		v |= (uint64)p[i] << (8 * i);
+	double value;
+	memcpy(&value, &v, sizeof(value));
+	return value;
+}
+
+int32 read_state(IBStream* stream, ParamSet* values, int32 count)
+{
+	if (!stream || count <= 0)
+		return 0;
+	IBStreamer streamer(stream, kLittleEndian);
+
+	uint8 header[state_header_size];
+	const TSize header_read = streamer.readRaw(header, state_header_size);
+	uint32 fields = legacy_fields_per_triad;
+	uint32 triads = (uint32)count;
+	std::vector<uint8> payload;
+	TSize payload_read = 0;
+	if (header_read == state_header_size && memcmp(header, state_magic, sizeof(state_magic)) == 0)
+	{
+		// Versioned layout.  Every version so far begins each record with InParam, OutParam, and Slowness,
+		// and later versions only append fields.  A version newer than ours may have changed what its fields
+		// mean, so it is rejected rather than guessed at.
+		const uint32 version = get_u32(header + 8);
+		if (version == 0 || version > state_version)
+			return -1;
+		triads = get_u32(header + 12);
+		fields = get_u32(header + 16);
+		const uint32 length = get_u32(header + 20);
+		if (fields == 0 || fields > max_state_fields_per_triad)
+			return -1;
+		if (triads > length / 8 / fields)
+			triads = length / 8 / fields;  // should never happen (writer recorded an inconsistent length)
+		if (triads > (uint32)count)
+			triads = (uint32)count;
+		payload.resize((size_t)triads * fields * 8);
+		if (!payload.empty())
+			payload_read = streamer.readRaw(payload.data(), (TSize)payload.size());
+	}
+	else
+	{
+		// Unversioned layout:  the bytes read so far are the start of the first record.
+		payload.resize((size_t)count * legacy_fields_per_triad * 8);
+		memcpy(payload.data(), header, (size_t)header_read);
+		payload_read = header_read;
+		if (header_read == state_header_size)
+			payload_read += streamer.readRaw(payload.data() + header_read, (TSize)payload.size() - header_read);
+	}
+
+	const uint32 record_size = fields * 8;
+	const uint32 available = (payload_read > 0) ? (uint32)(payload_read / record_size) : 0;
+	if (triads > available)
+		triads = available;
+	for (uint32 i = 0; i < triads; ++i)
+	{
+		const uint8* record = payload.data() + (size_t)i * record_size;
+		values[i].in = get_f64(record);
+		if (fields > 1)
+			values[i].out = get_f64(record + 8);
+		if (fields > 2)
+			values[i].slowness = get_f64(record + 16);
+		values[i].fall_slowness = (fields > 3) ? get_f64(record + 24) : values[i].slowness;
+		values[i].separate_fall = (fields > 4) && get_f64(record + 32) >= .5;
+		values[i].tempo_sync = (fields > 5) && get_f64(record + 40) >= .5;
+	}
+	return (int32)triads;
+}
+
+bool write_state(IBStream* stream, const ParamSet* values, int32 count)
+{
+	if (!stream || count < 0)
+		return false;
+
+	const uint32 length = (uint32)count * state_fields_per_triad * 8;
+	std::vector<uint8> buffer(state_header_size + length);
+	memcpy(buffer.data(), state_magic, sizeof(state_magic));
+	put_u32(buffer.data() + 8, state_version);
+	put_u32(buffer.data() + 12, (uint32)count);
+	put_u32(buffer.data() + 16, state_fields_per_triad);
+	put_u32(buffer.data() + 20, length);
+	uint8* record = buffer.data() + state_header_size;
+	for (int32 i = 0; i < count; ++i, record += state_fields_per_triad * 8)
+	{
+		put_f64(record, values[i].in);
+		put_f64(record + 8, values[i].out);
+		put_f64(record + 16, values[i].slowness);
+		put_f64(record + 24, values[i].fall_slowness);
+		put_f64(record + 32, values[i].separate_fall ? 1. : 0.);
+		put_f64(record + 40, values[i].tempo_sync ? 1. : 0.);
+	}
+
+	IBStreamer streamer(stream, kLittleEndian);
+	return streamer.writeRaw(buffer.data(), (TSize)buffer.size()) == (TSize)buffer.size();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Serialized form of Smoothie's state, shared by the processor (setState/getState) and the controller
+// (setComponentState).
+//
+// The state is a header followed by one record of doubles per triad, all little-endian, and is written and
+// read as a single block:
+//   8 bytes   magic "SMOOTHIE"
+//   uint32    format version (state_version)
+//   uint32    number of triads
+//   uint32    fields per triad (InParam, OutParam, Slowness, FallSlowness, SeparateFall, TempoSync, ...)
+//   uint32    payload length in bytes (triads * fields * 8)
+//   payload   triads * fields doubles
+// Readers reject states with a format version newer than their own (whose fields may mean something
+// else) or 0, ignore triads and fields they don't know about, and leave triads missing from the stream
+// unchanged, so older states survive changes in either.  Fields missing from a triad that is read (those
+// added after the state was written) are reset to behave as before they existed:  FallSlowness takes the
+// triad's Slowness, and the SeparateFall and TempoSync toggles are off.  Streams without the magic are read
+// in the original unversioned layout:  InParam, OutParam, and Slowness for each triad.  (That layout starts
+// with a double in [0,1], which can't be mistaken for the magic.)
+
+#include "pluginterfaces/base/ibstream.h"
+#include "SmoothieEngine.h"
+
+using namespace Steinberg;
+
+constexpr uint32 state_version = 2;
+constexpr uint32 state_fields_per_triad = 6;
+constexpr uint32 max_state_fields_per_triad = 1024;  // larger values mean a corrupt header
+
+// Read a state into values[0..count).  Returns the number of triads read (the rest of values is left
+// unchanged; a short stream yields only its complete triads), or -1 if the stream has an invalid header
+// (including one from a newer format version).
+int32 read_state(IBStream* stream, ParamSet* values, int32 count);
+
+// Write values[0..count) as a state.  Returns false on a stream error.
+bool write_state(IBStream* stream, const ParamSet* values, int32 count);
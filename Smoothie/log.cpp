@@ -1,7 +1,9 @@
 #include "Smoothie.h"
-#include "Windows.h"
 
 #ifdef LOGGING
+#ifdef _WIN32
+#include "Windows.h"
+
 constexpr LPCWSTR log_file = L"C:\\TestVST3.log";
 
 void log(const char* format, ...)
@@ -19,4 +21,23 @@ void log(const char* format, ...)
 		CloseHandle(h);
 	}
 }
+#else
+#include <cstdarg>
+#include <cstdio>
+
+constexpr const char* log_file = "/tmp/TestVST3.log";
+
+void log(const char* format, ...)
+{
+	FILE* f = fopen(log_file, "a");
+	if (f)
+	{
+		va_list args;
+		va_start(args, format);
+		vfprintf(f, format, args);
+		va_end(args);
+		fclose(f);
+	}
+}
+#endif
 #endif
@@ -0,0 +1,329 @@
+// smoothie-host:  headless stand-in for a DAW that loads the built Smoothie module and drives many instances
+// through a host's full lifecycle (factory, createInstance, initialize, connect, setState/setComponentState,
+// setupProcessing, setActive, and sustained process() calls with random InParam automation).  It reports
+// the time to bring up each instance (and, within that, the controller's startup and a generic editor's
+// listing of every parameter), the resident memory each instance adds, and the steady-state CPU cost of
+// processing, for sizing machines without a DAW.
+
+#include "public.sdk/source/vst/hosting/module.h"
+#include "public.sdk/source/vst/hosting/hostclasses.h"
+#include "public.sdk/source/vst/hosting/processdata.h"
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#include "public.sdk/source/vst/hosting/eventlist.h"
+#include "public.sdk/source/common/memorystream.h"
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "pluginterfaces/vst/ivsteditcontroller.h"
+#include "pluginterfaces/vst/ivstmessage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+// Same parameter layout as the plug-in (see Smoothie.h)
+constexpr int32 num_smoothed_params = 8;
+constexpr int32 num_param_offsets = 3;  // InParam, OutParam, Slowness
+constexpr int32 max_host_param_changes = num_smoothed_params * num_param_offsets;
+constexpr int32 max_host_events = 512;  // incoming (none are sent; the outgoing list is sized to the block)
+
+typedef struct instance {
+	IPtr<IComponent> component;
+	IPtr<IAudioProcessor> processor;
+	IPtr<IEditController> controller;
+	IPtr<IConnectionPoint> component_cp;
+	IPtr<IConnectionPoint> controller_cp;
+	double setup_secs = 0.;
+	double controller_init_secs = 0.;  // IEditController::initialize
+	double list_params_secs = 0.;  // info and display string of every parameter, as a generic editor asks for them
+} Instance;
+
+static double now_secs(clockid_t clock)
+{
+	timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Resident set size of this process in bytes, or 0 if unavailable.
+static double resident_bytes(void)
+{
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0.;
+	unsigned long long total = 0, resident = 0;
+	const int n = fscanf(f, "%llu %llu", &total, &resident);
+	fclose(f);
+	return (n == 2) ? (double)resident * sysconf(_SC_PAGESIZE) : 0.;
+}
+
+// Deterministic pseudo-random automation, so runs are comparable.
+static uint32 random_state = 12345;
+static double next_random(void)
+{
+	random_state = random_state * 1664525u + 1013904223u;
+	return (random_state >> 8) * (1. / 16777216.);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: smoothie-host [-n instances] [-r rate] [-b block] [-s seconds] [-a points] module\n"
+		"  -n instances  number of plug-in instances to run (default 50)\n"
+		"  -r rate       sample rate in Hz (default 48000)\n"
+		"  -b block      samples per processing block (default 512)\n"
+		"  -s seconds    audio time to process in the steady-state phase (default 10)\n"
+		"  -a points     InParam automation points per triad per block (default 4; 0 for none)\n"
+		"  module        path to the built Smoothie.vst3 bundle\n");
+}
+
+// Bring up one instance the way a host loading a saved project does.  Returns false on failure.
+static bool create_instance(const VST3::Hosting::PluginFactory& factory, const VST3::UID& uid, HostApplication& host,
+	const ProcessSetup& setup, Instance& inst)
+{
+	inst.component = factory.createInstance<IComponent>(uid);
+	if (!inst.component || inst.component->initialize(&host) != kResultOk)
+		return false;
+	inst.processor = FUnknownPtr<IAudioProcessor>(inst.component);
+	if (!inst.processor)
+		return false;
+
+	TUID controller_cid;
+	if (inst.component->getControllerClassId(controller_cid) != kResultOk)
+		return false;
+	inst.controller = factory.createInstance<IEditController>(VST3::UID::fromTUID(controller_cid));
+	if (!inst.controller)
+		return false;
+	const double t0 = now_secs(CLOCK_MONOTONIC);
+	if (inst.controller->initialize(&host) != kResultOk)
+		return false;
+	inst.controller_init_secs = now_secs(CLOCK_MONOTONIC) - t0;
+
+	inst.component_cp = FUnknownPtr<IConnectionPoint>(inst.component);
+	inst.controller_cp = FUnknownPtr<IConnectionPoint>(inst.controller);
+	if (inst.component_cp && inst.controller_cp)
+	{
+		inst.component_cp->connect(inst.controller_cp);
+		inst.controller_cp->connect(inst.component_cp);
+	}
+
+	// Round-trip the processor's state through both halves, as on project load.
+	MemoryStream state;
+	if (inst.component->getState(&state) != kResultOk)
+		return false;
+	state.seek(0, IBStream::kIBSeekSet, nullptr);
+	if (inst.component->setState(&state) != kResultOk)
+		return false;
+	state.seek(0, IBStream::kIBSeekSet, nullptr);
+	if (inst.controller->setComponentState(&state) != kResultOk)
+		return false;
+
+	ProcessSetup s = setup;
+	if (inst.processor->setupProcessing(s) != kResultOk)
+		return false;
+	for (int32 dir = kInput; dir <= kOutput; ++dir)
+		for (int32 i = 0; i < inst.component->getBusCount(kEvent, dir); ++i)
+			inst.component->activateBus(kEvent, dir, i, true);
+	if (inst.component->setActive(true) != kResultOk)
+		return false;
+	inst.processor->setProcessing(true);
+	return true;
+}
+
+// Fetch the info and display string of every parameter, as a host's generic editor does when it opens.
+// Returns the number of parameters.
+static int32 list_parameters(Instance& inst)
+{
+	const double t0 = now_secs(CLOCK_MONOTONIC);
+	const int32 count = inst.controller->getParameterCount();
+	for (int32 i = 0; i < count; ++i)
+	{
+		ParameterInfo info = {};
+		String128 display = {};
+		if (inst.controller->getParameterInfo(i, info) == kResultOk)
+			inst.controller->getParamStringByValue(info.id, inst.controller->getParamNormalized(info.id), display);
+	}
+	inst.list_params_secs = now_secs(CLOCK_MONOTONIC) - t0;
+	return count;
+}
+
+static void destroy_instance(Instance& inst)
+{
+	if (inst.processor)
+		inst.processor->setProcessing(false);
+	if (inst.component)
+		inst.component->setActive(false);
+	if (inst.component_cp && inst.controller_cp)
+	{
+		inst.component_cp->disconnect(inst.controller_cp);
+		inst.controller_cp->disconnect(inst.component_cp);
+	}
+	if (inst.controller)
+		inst.controller->terminate();
+	if (inst.component)
+		inst.component->terminate();
+	inst = Instance();
+}
+
+int main(int argc, char** argv)
+{
+	int32 num_instances = 50;
+	double sample_rate = 48000.;
+	int32 block_size = 512;
+	double seconds = 10.;
+	int32 automation_points = 4;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:b:s:a:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': num_instances = atoi(optarg); break;
+		case 'r': sample_rate = atof(optarg); break;
+		case 'b': block_size = atoi(optarg); break;
+		case 's': seconds = atof(optarg); break;
+		case 'a': automation_points = atoi(optarg); break;
+		default: usage(); return 2;
+		}
+	}
+	if (optind + 1 != argc || num_instances <= 0 || sample_rate <= 0. || block_size <= 0 || seconds < 0.
+		|| automation_points < 0 || automation_points > block_size)
+	{
+		usage();
+		return 2;
+	}
+
+	const double rss_start = resident_bytes();
+	double t0 = now_secs(CLOCK_MONOTONIC);
+	std::string error;
+	VST3::Hosting::Module::Ptr module = VST3::Hosting::Module::create(argv[optind], error);
+	if (!module)
+	{
+		fprintf(stderr, "smoothie-host: %s: %s\n", argv[optind], error.c_str());
+		return 1;
+	}
+	HostApplication host;
+	VST3::Hosting::PluginFactory factory = module->getFactory();
+	factory.setHostContext(&host);
+	const VST3::Hosting::ClassInfo* effect = nullptr;
+	std::vector<VST3::Hosting::ClassInfo> infos = factory.classInfos();
+	for (const VST3::Hosting::ClassInfo& info : infos)
+		if (info.category() == kVstAudioEffectClass)
+		{
+			effect = &info;
+			break;
+		}
+	if (!effect)
+	{
+		fprintf(stderr, "smoothie-host: %s: no audio effect class in module\n", argv[optind]);
+		return 1;
+	}
+	const double load_secs = now_secs(CLOCK_MONOTONIC) - t0;
+	const double rss_loaded = resident_bytes();
+
+	ProcessSetup setup = { kRealtime, kSample32, block_size, sample_rate };
+	std::vector<Instance> instances(num_instances);
+	for (int32 i = 0; i < num_instances; ++i)
+	{
+		t0 = now_secs(CLOCK_MONOTONIC);
+		if (!create_instance(factory, effect->ID(), host, setup, instances[i]))
+		{
+			fprintf(stderr, "smoothie-host: failed to bring up instance %d\n", i + 1);
+			return 1;
+		}
+		instances[i].setup_secs = now_secs(CLOCK_MONOTONIC) - t0;
+	}
+	const double rss_instances = resident_bytes();
+	int32 num_params = 0;
+	for (Instance& inst : instances)
+		num_params = list_parameters(inst);
+
+	// Steady state:  every instance processes each block in turn, as a host's audio thread would.
+	ProcessContext context = {};
+	context.sampleRate = sample_rate;
+	context.tempo = 120.;
+	context.state = ProcessContext::kPlaying | ProcessContext::kTempoValid;
+	HostProcessData data;
+	data.prepare(*instances[0].component, block_size, kSample32);
+	ParameterChanges changes(max_host_param_changes);
+	ParameterChanges changes_out(num_params);  // OutParam curves, and the initial point of every parameter
+	EventList events_in(max_host_events);
+	EventList events_out(block_size * num_smoothed_params);  // room for a CC change on every sample of every triad
+	data.processMode = kRealtime;
+	data.numSamples = block_size;
+	data.processContext = &context;
+	data.inputParameterChanges = &changes;
+	data.outputParameterChanges = &changes_out;
+	data.inputEvents = &events_in;
+	data.outputEvents = &events_out;
+
+	const int64 num_blocks = (int64)(seconds * sample_rate / block_size + 0.5);
+	std::vector<double> inparam_values(num_instances * num_smoothed_params, 0.);
+	int64 events_emitted = 0, points_emitted = 0;
+	double worst_call = 0.;
+	const double cpu_start = now_secs(CLOCK_PROCESS_CPUTIME_ID);
+	const double wall_start = now_secs(CLOCK_MONOTONIC);
+	for (int64 b = 0; b < num_blocks; ++b)
+	{
+		context.projectTimeSamples = b * block_size;
+		context.continousTimeSamples = b * block_size;
+		for (int32 i = 0; i < num_instances; ++i)
+		{
+			changes.clearQueue();
+			changes_out.clearQueue();
+			events_out.clear();
+			for (int32 k = 0; k < num_smoothed_params && automation_points > 0; ++k)
+			{
+				int32 queue_index = 0;
+				IParamValueQueue* q = changes.addParameterData(k * num_param_offsets, queue_index);
+				double& value = inparam_values[i * num_smoothed_params + k];
+				for (int32 p = 0; p < automation_points; ++p)
+				{
+					value = std::min(1., std::max(0., value + (next_random() - 0.5) * 0.1));
+					int32 point_index = 0;
+					q->addPoint((int32)((int64)(p + 1) * block_size / automation_points) - 1, value, point_index);
+				}
+			}
+			const double call_start = now_secs(CLOCK_MONOTONIC);
+			instances[i].processor->process(data);
+			worst_call = std::max(worst_call, now_secs(CLOCK_MONOTONIC) - call_start);
+			events_emitted += events_out.getEventCount();
+			for (int32 k = 0; k < changes_out.getParameterCount(); ++k)
+				points_emitted += changes_out.getParameterData(k)->getPointCount();
+		}
+	}
+	const double cpu_secs = now_secs(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+	const double wall_secs = now_secs(CLOCK_MONOTONIC) - wall_start;
+	data.unprepare();
+
+	double setup_total = 0., setup_worst = 0., controller_init_total = 0., list_params_total = 0.;
+	for (const Instance& inst : instances)
+	{
+		setup_total += inst.setup_secs;
+		setup_worst = std::max(setup_worst, inst.setup_secs);
+		controller_init_total += inst.controller_init_secs;
+		list_params_total += inst.list_params_secs;
+	}
+	for (Instance& inst : instances)
+		destroy_instance(inst);
+	const double audio_secs = (double)num_blocks * block_size / sample_rate;
+	const double calls = (double)num_blocks * num_instances;
+
+	printf("module load:        %.3f ms, %.1f KiB resident\n", load_secs * 1e3, (rss_loaded - rss_start) / 1024.);
+	printf("instance bring-up:  %.3f ms average, %.3f ms worst (%d instances)\n",
+		setup_total / num_instances * 1e3, setup_worst * 1e3, num_instances);
+	printf("controller startup: %.3f ms initialize, %.3f ms to list %d parameters with display strings (average)\n",
+		controller_init_total / num_instances * 1e3, list_params_total / num_instances * 1e3, num_params);
+	printf("memory:             %.1f KiB resident per instance\n", (rss_instances - rss_loaded) / num_instances / 1024.);
+	printf("steady state:       %.3f s of audio in %.3f s CPU (%.2f%% of one core for all instances)\n",
+		audio_secs, cpu_secs, audio_secs > 0. ? cpu_secs / audio_secs * 100. : 0.);
+	printf("process():          %.2f us average, %.2f us worst, %lld events and %lld parameter points emitted (%.1f%% of wall time)\n",
+		calls > 0. ? cpu_secs / calls * 1e6 : 0., worst_call * 1e6, (long long)events_emitted, (long long)points_emitted,
+		audio_secs > 0. ? wall_secs / audio_secs * 100. : 0.);
+	return 0;
+}
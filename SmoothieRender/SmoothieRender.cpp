@@ -0,0 +1,389 @@
+// smoothie-render:  headless batch renderer that runs automation curves through Smoothie's smoothing
+// engine offline and writes the smoothed OutParam curves (CSV) and the CC output (Standard MIDI File).
+//
+// Input points are streamed block by block, so memory use is constant regardless of input length.
+// See README.md for the input and output formats.
+
+#include "SmoothieEngine.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <unistd.h>
+#include <vector>
+
+typedef int32_t int32;
+typedef int64_t int64;
+typedef uint8_t uint8;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+// Same parameter layout and CC assignment as the plug-in (see Smoothie.h)
+constexpr uint32 num_smoothed_params = 8;
+constexpr uint32 num_param_offsets = 3;  // InParam, OutParam, Slowness
+constexpr uint32 num_extra_param_offsets = 3;  // FallSlowness, SeparateFall, TempoSync
+constexpr uint32 extra_params_base = num_smoothed_params * num_param_offsets;
+constexpr uint32 num_params = extra_params_base + num_smoothed_params * num_extra_param_offsets;
+constexpr uint8 cc = 90;
+
+constexpr char binary_magic[4] = { 'S', 'M', 'B', '1' };
+constexpr int32 midi_ticks_per_quarter = 500;  // at the default 120 bpm this is 1000 ticks per second
+constexpr int32 midi_usecs_per_quarter = 500000;
+
+typedef struct input_point {
+	int64 sample;
+	uint32 id;
+	double value;
+} InputPoint;
+
+// Sequential reader for input curve points, in either CSV or binary form.  The input need not be seekable
+// (e.g., a pipe):  the bytes read to detect the format are replayed to the CSV parser rather than re-read.
+class PointReader
+{
+public:
+	PointReader(FILE* f) : file(f)
+	{
+		peek_len = fread(peek, 1, sizeof(peek), file);
+		if (peek_len == sizeof(binary_magic) && !memcmp(peek, binary_magic, sizeof(binary_magic)))
+		{
+			binary = true;
+			peek_len = 0;
+		}
+	}
+
+	// Read the next point into p.  Returns false at end of input or on a malformed record (see error).
+	bool next(InputPoint& p)
+	{
+		return binary ? nextBinary(p) : nextText(p);
+	}
+
+	const char* error = nullptr;
+	int64 line = 0;
+
+private:
+	FILE* file;
+	bool binary = false;
+	char peek[sizeof(binary_magic)];  // bytes read ahead to detect the format, not yet parsed
+	size_t peek_len = 0;
+	size_t peek_pos = 0;
+
+	bool checkValue(const InputPoint& p)
+	{
+		if (std::isnan(p.value))
+		{
+			error = "value is not a number";
+			return false;
+		}
+		return true;
+	}
+
+	// Like fgets, but starting with any bytes read ahead.  Returns false at end of input.
+	bool readLine(char* buf, int size)
+	{
+		int n = 0;
+		while (peek_pos < peek_len && n < size - 1)
+		{
+			buf[n++] = peek[peek_pos++];
+			if (buf[n - 1] == '\n')
+				break;
+		}
+		buf[n] = 0;
+		if (n > 0 && (buf[n - 1] == '\n' || n == size - 1))
+			return true;
+		return fgets(buf + n, size - n, file) || n > 0;
+	}
+
+	bool nextBinary(InputPoint& p)
+	{
+		uint8 rec[8 + 4 + 8];
+		const size_t n = fread(rec, 1, sizeof(rec), file);
+		++line;
+		if (n == 0)
+			return false;
+		if (n != sizeof(rec))
+		{
+			error = "truncated binary record";
+			return false;
+		}
+		uint64 sample = 0, bits = 0;
+		uint32 id = 0;
+		for (int i = 7; i >= 0; --i) sample = (sample << 8) | rec[i];
+		for (int i = 3; i >= 0; --i) id = (id << 8) | rec[8 + i];
+		for (int i = 7; i >= 0; --i) bits = (bits << 8) | rec[12 + i];
+		p.sample = (int64)sample;
+		p.id = id;
+		memcpy(&p.value, &bits, sizeof(p.value));
+		return checkValue(p);
+	}
+
+	bool nextText(InputPoint& p)
+	{
+		char buf[256];
+		while (readLine(buf, sizeof(buf)))
+		{
+			++line;
+			const char* s = buf;
+			while (*s == ' ' || *s == '\t') ++s;
+			if (*s < '0' || *s > '9')
+				continue;  // blank line, comment, or header
+			long long sample;
+			unsigned id;
+			double value;
+			if (sscanf(s, "%lld , %u , %lf", &sample, &id, &value) != 3)
+			{
+				error = "expected sample,param,value";
+				return false;
+			}
+			p.sample = sample;
+			p.id = id;
+			p.value = value;
+			return checkValue(p);
+		}
+		return false;
+	}
+};
+
+// Format-0 Standard MIDI File writer.  The track length is patched in when the file is closed,
+// so the output must be seekable.
+class MidiFileWriter
+{
+public:
+	bool open(const char* path, double sample_rate)
+	{
+		file = fopen(path, "wb");
+		if (!file)
+			return false;
+		ticks_per_sample = (double)midi_ticks_per_quarter * 1000000. / midi_usecs_per_quarter / sample_rate;
+
+		const uint8 header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1,
+			(uint8)(midi_ticks_per_quarter >> 8), (uint8)midi_ticks_per_quarter,
+			'M', 'T', 'r', 'k', 0, 0, 0, 0 };
+		fwrite(header, 1, sizeof(header), file);
+		length_pos = ftell(file) - 4;
+
+		const uint8 tempo[] = { 0xFF, 0x51, 0x03,
+			(uint8)(midi_usecs_per_quarter >> 16), (uint8)(midi_usecs_per_quarter >> 8), (uint8)midi_usecs_per_quarter };
+		writeEvent(0, tempo, sizeof(tempo));
+		return true;
+	}
+
+	void writeCC(int64 sample, uint8 channel, uint8 controller, uint8 value)
+	{
+		const uint8 msg[] = { (uint8)(0xB0 | (channel & 0x0F)), (uint8)(controller & 0x7F), (uint8)(value & 0x7F) };
+		writeEvent((int64)std::llround((double)sample * ticks_per_sample), msg, sizeof(msg));
+	}
+
+	bool close(void)
+	{
+		if (!file)
+			return true;
+		const uint8 eot[] = { 0xFF, 0x2F, 0x00 };
+		writeEvent(last_tick, eot, sizeof(eot));
+
+		const uint8 len[] = { (uint8)(track_length >> 24), (uint8)(track_length >> 16), (uint8)(track_length >> 8), (uint8)track_length };
+		bool ok = (fseek(file, length_pos, SEEK_SET) == 0) && (fwrite(len, 1, sizeof(len), file) == sizeof(len));
+		ok = (fclose(file) == 0) && ok;
+		file = nullptr;
+		return ok;
+	}
+
+private:
+	FILE* file = nullptr;
+	long length_pos = 0;
+	uint32 track_length = 0;
+	int64 last_tick = 0;
+	double ticks_per_sample = 1.;
+
+	void writeEvent(int64 tick, const uint8* msg, uint32 size)
+	{
+		if (tick < last_tick)
+			tick = last_tick;
+		uint64 delta = (uint64)(tick - last_tick);
+		last_tick = tick;
+
+		uint8 vlq[10];
+		int n = 0;
+		vlq[n++] = (uint8)(delta & 0x7F);
+		while (delta >>= 7)
+			vlq[n++] = (uint8)(0x80 | (delta & 0x7F));
+		while (n > 0)
+			fputc(vlq[--n], file);
+		fwrite(msg, 1, size, file);
+		track_length += (uint32)n + size;
+	}
+};
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: smoothie-render [-r rate] [-T tempo] [-b block] [-p points] [-t seconds] [-o curves.csv] [-m output.mid] input\n"
+		"  -r rate     sample rate in Hz (default 48000)\n"
+		"  -T tempo    tempo in beats per minute, for triads with TempoSync on (default 120)\n"
+		"  -b block    samples per processing block (default 512)\n"
+		"  -p points   most points of each input curve to use per block; more are decimated (default 1024)\n"
+		"  -t seconds  keep rendering this long after the last input point (default 0)\n"
+		"  -o file     write smoothed OutParam points as sample,param,value CSV (default stdout; - for stdout)\n"
+		"  -m file     write CC output as a Standard MIDI File\n"
+		"  input       CSV (sample,param,value) or binary curve file, sorted by sample; - for stdin\n");
+}
+
+int main(int argc, char** argv)
+{
+	double sample_rate = 48000.;
+	double tempo = default_tempo;
+	int32 block_size = 512;
+	int32 point_budget = default_point_budget;
+	double tail_secs = 0.;
+	const char* curves_path = "-";
+	const char* midi_path = nullptr;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:T:b:p:t:o:m:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': sample_rate = atof(optarg); break;
+		case 'T': tempo = atof(optarg); break;
+		case 'b': block_size = atoi(optarg); break;
+		case 'p': point_budget = atoi(optarg); break;
+		case 't': tail_secs = atof(optarg); break;
+		case 'o': curves_path = optarg; break;
+		case 'm': midi_path = optarg; break;
+		default: usage(); return 2;
+		}
+	}
+	if (optind + 1 != argc || sample_rate <= 0. || tempo <= 0. || block_size <= 0 || point_budget < 2 || tail_secs < 0.)
+	{
+		usage();
+		return 2;
+	}
+
+	FILE* in = strcmp(argv[optind], "-") ? fopen(argv[optind], "rb") : stdin;
+	if (!in)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	FILE* curves = strcmp(curves_path, "-") ? fopen(curves_path, "w") : stdout;
+	if (!curves)
+	{
+		perror(curves_path);
+		return 1;
+	}
+	MidiFileWriter midi;
+	if (midi_path && !midi.open(midi_path, sample_rate))
+	{
+		perror(midi_path);
+		return 1;
+	}
+
+	ParamSet states[num_smoothed_params];
+	std::vector<CurvePoint> curves_in[num_smoothed_params][num_param_offsets + num_extra_param_offsets];
+	std::vector<CurvePoint> points_out[num_smoothed_params];
+	std::vector<CCChange> cc_out[num_smoothed_params];
+	SmootherInput inputs[num_smoothed_params];
+	SmootherOutput outputs[num_smoothed_params];
+	for (uint32 i = 0; i < num_smoothed_params; ++i)
+		cc_out[i].resize(block_size);
+
+	InputPoint point;
+	PointReader reader(in);
+	bool have_point = reader.next(point);
+	int64 last_sample = -1;
+	int64 dropped = 0;
+	int64 end_sample = -1;  // known once the input is exhausted
+	const int64 tail_samples = (int64)std::ceil(tail_secs * sample_rate);
+
+	for (int64 pos = 0; end_sample < 0 || pos < end_sample; pos += block_size)
+	{
+		// Gather the input points that fall within this block.
+		for (uint32 i = 0; i < num_smoothed_params; ++i)
+			for (uint32 j = 0; j < num_param_offsets + num_extra_param_offsets; ++j)
+				curves_in[i][j].clear();
+		while (have_point && point.sample < pos + block_size)
+		{
+			if (point.sample < last_sample)
+			{
+				fprintf(stderr, "smoothie-render: input record %lld is out of order\n", (long long)reader.line);
+				return 1;
+			}
+			last_sample = point.sample;
+			if (point.id < extra_params_base)
+				curves_in[point.id / num_param_offsets][point.id % num_param_offsets].push_back({ (int32)(point.sample - pos), point.value });
+			else if (point.id < num_params)
+				curves_in[(point.id - extra_params_base) / num_extra_param_offsets][num_param_offsets + (point.id - extra_params_base) % num_extra_param_offsets].push_back({ (int32)(point.sample - pos), point.value });
+			have_point = reader.next(point);
+		}
+		if (reader.error)
+		{
+			fprintf(stderr, "smoothie-render: input record %lld: %s\n", (long long)reader.line, reader.error);
+			return 1;
+		}
+		if (!have_point && end_sample < 0)
+			end_sample = last_sample + 1 + tail_samples;
+
+		for (uint32 i = 0; i < num_smoothed_params; ++i)
+		{
+			for (uint32 j = 0; j < num_param_offsets + num_extra_param_offsets; ++j)
+			{
+				const int32 n = (int32)curves_in[i][j].size();
+				const int32 kept = decimate_curve(curves_in[i][j].data(), n, point_budget);
+				curves_in[i][j].resize(kept);
+				dropped += n - kept;
+			}
+			inputs[i].in = { curves_in[i][0].data(), simplify_ramps(curves_in[i][0].data(), (int32)curves_in[i][0].size(), default_ramp_tolerance) };
+			inputs[i].out = { curves_in[i][1].data(), (int32)curves_in[i][1].size() };
+			inputs[i].slowness = { curves_in[i][2].data(), simplify_steps(curves_in[i][2].data(), (int32)curves_in[i][2].size()) };
+			inputs[i].fall_slowness = { curves_in[i][3].data(), simplify_steps(curves_in[i][3].data(), (int32)curves_in[i][3].size()) };
+			// As in the plug-in, mode switches take effect for the whole block in which they arrive.
+			if (!curves_in[i][4].empty())
+				states[i].separate_fall = (curves_in[i][4].back().value >= .5);
+			if (!curves_in[i][5].empty())
+				states[i].tempo_sync = (curves_in[i][5].back().value >= .5);
+			points_out[i].resize(max_output_points(inputs[i]));
+			outputs[i].points = points_out[i].data();
+			outputs[i].point_capacity = (int32)points_out[i].size();
+			outputs[i].cc = midi_path ? cc_out[i].data() : nullptr;
+			outputs[i].cc_capacity = block_size;
+		}
+		smooth_blocks(num_smoothed_params, states, inputs, block_size, sample_rate, outputs, tempo);
+
+		for (uint32 i = 0; i < num_smoothed_params; ++i)
+			for (int32 j = 0; j < outputs[i].point_count; ++j)
+				fprintf(curves, "%lld,%u,%.9f\n", (long long)(pos + outputs[i].points[j].offset), i * num_param_offsets + 1, outputs[i].points[j].value);
+
+		// Merge the triads' CC changes into one time-ordered stream.
+		if (midi_path)
+		{
+			int32 next[num_smoothed_params] = {};
+			for (;;)
+			{
+				int32 best = -1;
+				for (uint32 i = 0; i < num_smoothed_params; ++i)
+					if (next[i] < outputs[i].cc_count && (best < 0 || outputs[i].cc[next[i]].offset < outputs[best].cc[next[best]].offset))
+						best = (int32)i;
+				if (best < 0)
+					break;
+				const CCChange& change = outputs[best].cc[next[best]++];
+				midi.writeCC(pos + change.offset, 0, (uint8)(cc + best), change.value);
+			}
+		}
+	}
+
+	bool ok = midi.close();
+	if (curves != stdout)
+		ok = (fclose(curves) == 0) && ok;
+	else
+		ok = (fflush(stdout) == 0) && ok;
+	if (in != stdin)
+		fclose(in);
+	if (!ok)
+	{
+		fprintf(stderr, "smoothie-render: error writing output\n");
+		return 1;
+	}
+	if (dropped > 0)
+		fprintf(stderr, "smoothie-render: decimated %lld input points over the per-block budget\n", (long long)dropped);
+	return 0;
+}
@@ -0,0 +1,202 @@
+// smoothie-kernel-test:  checks that each kernel specialized for a common block shape (and the closed-form
+// smooth_ramp, and smooth_block's shortcut for parked smoothers) produces exactly the output of the general
+// kernel, smooth_kernel<true, true, true>, on random blocks of that shape:  the same OutParam points, CC
+// changes, and final state, bit for bit.
+//
+// The kernels are internal to the engine, so this includes its source directly.
+
+#include "SmoothieEngine.cpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+typedef int32_t int32;
+typedef uint32_t uint32;
+
+constexpr int32 num_cases = 50000;  // per block shape
+constexpr int32 max_block_size = 1024;
+constexpr int32 max_curve_points = 12;
+constexpr int32 max_reported_mismatches = 5;
+
+enum BlockShape
+{
+	NoPoints = 0,  // smooth_ramp, smooth_kernel<false, false, false>, and smooth_block (which may skip the block)
+	InOnly = 1,  // smooth_kernel<true, false, false>
+	SlownessOnly = 2,  // smooth_kernel<false, false, true>
+	NumBlockShapes = 3,
+};
+
+static const char* const shape_names[NumBlockShapes] = { "no points", "InParam only", "Slowness only" };
+
+typedef struct block_result {
+	ParamSet state;
+	std::vector<CurvePoint> points;
+	std::vector<CCChange> cc;
+	SmootherOutput output;
+} BlockResult;
+
+static std::mt19937_64 rng(20240229);
+
+static double uniform(double lo, double hi)
+{
+	return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+static int32 uniform_int(int32 lo, int32 hi)
+{
+	return std::uniform_int_distribution<int32>(lo, hi)(rng);
+}
+
+// A random value for a curve, mostly within [0,1] but occasionally outside it (the engine clamps), and often
+// exactly 0 or 1
+static double random_value(void)
+{
+	switch (uniform_int(0, 9))
+	{
+	case 0: return 0.;
+	case 1: return 1.;
+	case 2: return uniform(-0.1, 1.1);
+	default: return uniform(0., 1.);
+	}
+}
+
+// A random Slowness, including the extremes and fast settings whose catch-ups fall within a few samples
+static double random_slowness(void)
+{
+	switch (uniform_int(0, 5))
+	{
+	case 0: return 0.;
+	case 1: return 1.;
+	case 2: return uniform(0., 0.001);
+	default: return uniform(0., 1.);
+	}
+}
+
+// A random curve with sorted offsets in [0, num_samples), sometimes with several points at one offset (jumps)
+static void random_curve(std::vector<CurvePoint>& curve, int32 num_samples, bool slowness)
+{
+	curve.resize(uniform_int(1, max_curve_points));
+	for (CurvePoint& p : curve)
+	{
+		p.offset = uniform_int(0, num_samples - 1);
+		p.value = slowness ? random_slowness() : random_value();
+	}
+	std::sort(curve.begin(), curve.end(), [](const CurvePoint& a, const CurvePoint& b) { return a.offset < b.offset; });
+}
+
+// A random smoother state, often with OutParam at or within a rounding error of InParam
+static ParamSet random_state(void)
+{
+	ParamSet state;
+	state.in = uniform(0., 1.);
+	switch (uniform_int(0, 4))
+	{
+	case 0: state.out = state.in; break;
+	case 1: state.out = state.in + uniform(-2e-5, 2e-5); break;
+	case 2: state.out = state.in + uniform(-2e-12, 2e-12); break;
+	default: state.out = uniform(0., 1.); break;
+	}
+	CONSTRAIN(state.out);
+	state.slowness = random_slowness();
+	state.fall_slowness = random_slowness();
+	state.separate_fall = (uniform_int(0, 1) == 0);
+	state.tempo_sync = (uniform_int(0, 2) == 0);
+	state.last_cc = (uniform_int(0, 2) == 0) ? -1 : uniform_int(0, 127);
+	return state;
+}
+
+static void prepare(BlockResult& result, const ParamSet& state, const SmootherInput& input, int32 num_samples)
+{
+	result.state = state;
+	result.points.assign(max_output_points(input), CurvePoint());
+	result.cc.assign(num_samples, CCChange());
+	result.output = SmootherOutput();
+	result.output.points = result.points.data();
+	result.output.point_capacity = (int32)result.points.size();
+	result.output.cc = result.cc.data();
+	result.output.cc_capacity = (int32)result.cc.size();
+}
+
+static bool same_result(const BlockResult& a, const BlockResult& b)
+{
+	if (a.state.in != b.state.in || a.state.out != b.state.out || a.state.slowness != b.state.slowness
+		|| a.state.fall_slowness != b.state.fall_slowness || a.state.last_cc != b.state.last_cc
+		|| a.output.point_count != b.output.point_count || a.output.cc_count != b.output.cc_count
+		|| a.output.overrides != b.output.overrides)
+		return false;
+	for (int32 i = 0; i < a.output.point_count; ++i)
+		if (a.points[i].offset != b.points[i].offset || a.points[i].value != b.points[i].value)
+			return false;
+	for (int32 i = 0; i < a.output.cc_count; ++i)
+		if (a.cc[i].offset != b.cc[i].offset || a.cc[i].value != b.cc[i].value)
+			return false;
+	return true;
+}
+
+int main(void)
+{
+	int32 mismatches = 0;
+	std::vector<CurvePoint> in_curve, slowness_curve, fall_curve;
+	BlockResult general, specialized, unspecialized;
+	for (int32 shape = 0; shape < NumBlockShapes; ++shape)
+	{
+		int32 shape_mismatches = 0;
+		for (int32 n = 0; n < num_cases; ++n)
+		{
+			const ParamSet state = random_state();
+			const int32 num_samples = uniform_int(1, max_block_size);
+			const double sample_rate = (uniform_int(0, 1) == 0) ? 44100. : 48000.;
+			const double tempo = uniform(40., 240.);
+
+			SmootherInput input;
+			if (shape == InOnly)
+			{
+				random_curve(in_curve, num_samples, false);
+				input.in = { in_curve.data(), (int32)in_curve.size() };
+			}
+			else if (shape == SlownessOnly)
+			{
+				const int32 which = uniform_int(0, 2);  // Slowness, FallSlowness, or both
+				if (which != 1)
+				{
+					random_curve(slowness_curve, num_samples, true);
+					input.slowness = { slowness_curve.data(), (int32)slowness_curve.size() };
+				}
+				if (which != 0)
+				{
+					random_curve(fall_curve, num_samples, true);
+					input.fall_slowness = { fall_curve.data(), (int32)fall_curve.size() };
+				}
+			}
+
+			prepare(general, state, input, num_samples);
+			smooth_kernel<true, true, true>(general.state, input, num_samples, sample_rate, general.output, tempo);
+			prepare(specialized, state, input, num_samples);
+			bool same = true;
+			if (shape == NoPoints)
+			{
+				smooth_ramp(specialized.state, num_samples, sample_rate, specialized.output, tempo);
+				prepare(unspecialized, state, input, num_samples);
+				smooth_kernel<false, false, false>(unspecialized.state, input, num_samples, sample_rate, unspecialized.output, tempo);
+				same = same_result(general, unspecialized);
+				prepare(unspecialized, state, input, num_samples);
+				smooth_block(unspecialized.state, input, num_samples, sample_rate, unspecialized.output, tempo);
+				same = same && same_result(general, unspecialized);
+			}
+			else if (shape == InOnly)
+				smooth_kernel<true, false, false>(specialized.state, input, num_samples, sample_rate, specialized.output, tempo);
+			else
+				smooth_kernel<false, false, true>(specialized.state, input, num_samples, sample_rate, specialized.output, tempo);
+			same = same && same_result(general, specialized);
+
+			if (!same && ++shape_mismatches <= max_reported_mismatches)
+				fprintf(stderr, "smoothie-kernel-test: %s case %d differs (in=%.17g out=%.17g slowness=%.17g fall=%.17g, %d samples)\n",
+					shape_names[shape], n, state.in, state.out, state.slowness, state.fall_slowness, num_samples);
+		}
+		printf("%s: %d cases, %d mismatches\n", shape_names[shape], num_cases, shape_mismatches);
+		mismatches += shape_mismatches;
+	}
+	return (mismatches == 0) ? 0 : 1;
+}
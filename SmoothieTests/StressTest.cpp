@@ -0,0 +1,182 @@
+// smoothie-stress-test:  feeds the smoothing engine adversarial automation, as a buggy host or automation
+// lane might send it, through the same pipeline as the plug-in's process() (read_decimated, which enforces
+// the point budget as the plug-in reads host queues, then simplification, then smooth_blocks for all
+// triads), and checks that every block finishes well within its own duration in real time and that every
+// output stays in range.
+//
+// Each curve gets up to hundreds of thousands of points per block, with unsorted offsets, runs of duplicate
+// offsets, offsets outside the block, values in [-1, 2] mixed with infinities and NaNs, and points the
+// "host" fails to serve.  Since reading skips NaN points, NaNs and infinities also go straight into the
+// stored state now and then, as a corrupt saved state could put them there.
+
+#include "SmoothieEngine.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+constexpr uint32 num_smoothed_params = 8;  // as in the plug-in (see Smoothie.h)
+constexpr uint32 num_curves = 4;  // InParam, OutParam, Slowness, FallSlowness
+constexpr int32 num_blocks = 32;
+constexpr int32 block_size = 1024;
+constexpr double sample_rate = 48000.;
+constexpr int32 curve_lengths[] = { 1, 7, 600, 5000, 300000 };  // points per curve, cycled through by block
+constexpr int32 max_reported_errors = 5;
+
+// Deterministic pseudo-random numbers, so runs are comparable (and cheap enough to generate millions of points).
+static uint64 random_state = 12345;
+static uint32 next_random(void)
+{
+	random_state = random_state * 6364136223846793005ull + 1442695040888963407ull;
+	return (uint32)(random_state >> 32);
+}
+
+// A value for a curve or the stored state:  usually in [-1, 2], sometimes NaN or infinite
+static double random_value(void)
+{
+	switch (next_random() % 64)
+	{
+	case 0: return std::numeric_limits<double>::quiet_NaN();
+	case 1: return std::numeric_limits<double>::infinity();
+	case 2: return -std::numeric_limits<double>::infinity();
+	default: return -1. + 3. * (next_random() * (1. / 4294967296.));
+	}
+}
+
+// An adversarial curve:  mostly random offsets (some outside the block), with runs of duplicate offsets
+static void random_curve(std::vector<CurvePoint>& curve, int32 count)
+{
+	curve.resize(count);
+	for (int32 i = 0; i < count; ++i)
+	{
+		if (i > 0 && next_random() % 4 == 0)
+			curve[i].offset = curve[i - 1].offset;
+		else
+			curve[i].offset = (int32)(next_random() % (block_size + 200)) - 100;
+		curve[i].value = random_value();
+	}
+}
+
+static int32 errors = 0;
+static void fail(int32 block, uint32 triad, const char* what, double value)
+{
+	if (++errors <= max_reported_errors)
+		fprintf(stderr, "smoothie-stress-test: block %d, triad %u: %s (%.17g)\n", block, triad + 1, what, value);
+}
+
+static bool in_unit_range(double value)
+{
+	return value >= 0. && value <= 1.;
+}
+
+int main(void)
+{
+	ParamSet states[num_smoothed_params];
+	std::vector<CurvePoint> curves[num_smoothed_params][num_curves];  // as the host serves them
+	std::vector<CurvePoint> storage[num_smoothed_params][num_curves];  // as the plug-in reads them
+	std::vector<CurvePoint> points_out[num_smoothed_params];
+	std::vector<CCChange> cc_out[num_smoothed_params];
+	SmootherInput inputs[num_smoothed_params];
+	SmootherOutput outputs[num_smoothed_params];
+	for (uint32 i = 0; i < num_smoothed_params; ++i)
+	{
+		cc_out[i].resize(block_size);
+		for (uint32 j = 0; j < num_curves; ++j)
+			storage[i][j].resize(default_point_budget);  // as preallocated by setupProcessing
+	}
+
+	// Each block must finish in well under the time it takes to play; a real-time host would need it in less.
+	const double bound_secs = block_size / sample_rate;
+	double worst_secs = 0.;
+	const int32 num_lengths = (int32)(sizeof(curve_lengths) / sizeof(*curve_lengths));
+	for (int32 b = 0; b < num_blocks; ++b)
+	{
+		const int32 count = curve_lengths[b % num_lengths];
+		for (uint32 i = 0; i < num_smoothed_params; ++i)
+		{
+			for (uint32 j = 0; j < num_curves; ++j)
+				random_curve(curves[i][j], count);
+			states[i].separate_fall = (next_random() % 2 == 0);
+			states[i].tempo_sync = (next_random() % 2 == 0);
+			if (next_random() % 8 == 0)
+				states[i].in = random_value();
+			if (next_random() % 8 == 0)
+				states[i].out = random_value();
+			if (next_random() % 8 == 0)
+				states[i].slowness = random_value();
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32 i = 0; i < num_smoothed_params; ++i)
+		{
+			// As in the plug-in's process():  read within the point budget (see read_curve), then simplify.
+			int32 n[num_curves];
+			for (uint32 j = 0; j < num_curves; ++j)
+			{
+				const std::vector<CurvePoint>& queue = curves[i][j];
+				n[j] = read_decimated((int32)queue.size(), (int32)storage[i][j].size(), storage[i][j].data(),
+					[&queue](int32 k, CurvePoint& p) { p = queue[k]; return k % 97 != 13; });  // (some fail, as getPoint can)
+				if (n[j] > default_point_budget)
+					fail(b, i, "curve read over the point budget", n[j]);
+				for (int32 k = 0; k < n[j]; ++k)
+					if (std::isnan(storage[i][j][k].value))
+						fail(b, i, "curve read with a NaN point", k);
+			}
+			inputs[i].in = { storage[i][0].data(), simplify_ramps(storage[i][0].data(), n[0], default_ramp_tolerance) };
+			inputs[i].out = { storage[i][1].data(), n[1] };
+			inputs[i].slowness = { storage[i][2].data(), simplify_steps(storage[i][2].data(), n[2]) };
+			inputs[i].fall_slowness = { storage[i][3].data(), simplify_steps(storage[i][3].data(), n[3]) };
+			points_out[i].resize(max_output_points(inputs[i]));  // (within the plug-in's preallocation for the budget)
+			outputs[i].points = points_out[i].data();
+			outputs[i].point_capacity = (int32)points_out[i].size();
+			outputs[i].cc = cc_out[i].data();
+			outputs[i].cc_capacity = block_size;
+		}
+		const double tempo = 20. + (next_random() % 280);  // (the plug-in passes only positive tempos)
+		smooth_blocks(num_smoothed_params, states, inputs, block_size, sample_rate, outputs, tempo);
+		const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (secs > worst_secs)
+			worst_secs = secs;
+		if (secs > bound_secs)
+			fail(b, 0, "block took longer than its duration (seconds)", secs);
+
+		for (uint32 i = 0; i < num_smoothed_params; ++i)
+		{
+			const SmootherOutput& out = outputs[i];
+			for (int32 k = 0; k < out.point_count; ++k)
+			{
+				if (out.points[k].offset < 0 || out.points[k].offset >= block_size)
+					fail(b, i, "OutParam point outside the block", out.points[k].offset);
+				if (!in_unit_range(out.points[k].value))
+					fail(b, i, "OutParam point out of range", out.points[k].value);
+			}
+			for (int32 k = 0; k < out.cc_count; ++k)
+			{
+				if (out.cc[k].offset < 0 || out.cc[k].offset >= block_size)
+					fail(b, i, "CC change outside the block", out.cc[k].offset);
+				if (out.cc[k].value > 127)
+					fail(b, i, "CC value out of range", out.cc[k].value);
+			}
+			if (!in_unit_range(states[i].in))
+				fail(b, i, "stored InParam out of range", states[i].in);
+			if (!in_unit_range(states[i].out))
+				fail(b, i, "stored OutParam out of range", states[i].out);
+			if (!in_unit_range(states[i].slowness))
+				fail(b, i, "stored Slowness out of range", states[i].slowness);
+			if (!in_unit_range(states[i].fall_slowness))
+				fail(b, i, "stored FallSlowness out of range", states[i].fall_slowness);
+			if (samples_to_converge(states[i], sample_rate) < 0)
+				fail(b, i, "negative tail", (double)samples_to_converge(states[i], sample_rate));
+		}
+	}
+
+	printf("%d blocks of up to %d points per curve:  worst block %.3f ms (bound %.3f ms), %d errors\n",
+		num_blocks, curve_lengths[num_lengths - 1], worst_secs * 1e3, bound_secs * 1e3, errors);
+	return (errors == 0) ? 0 : 1;
+}